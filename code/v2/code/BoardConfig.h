@@ -0,0 +1,86 @@
+#ifndef BOARD_CONFIG_H
+#define BOARD_CONFIG_H
+
+#include <Arduino.h>
+#include "MotorPwm.h"
+
+#if defined(ESP32)
+    #include "soc/gpio_struct.h"
+#endif
+
+// Board traits: every driver is specialised on one of these pin sets, so pin
+// numbers and port masks are compile-time constants.
+namespace Board {
+
+constexpr uint8_t NO_PIN = 255;
+
+struct Esp8266Pins {
+    static constexpr uint8_t MOTOR1_IN1 = 5, MOTOR1_IN2 = 4, MOTOR2_IN1 = 0, MOTOR2_IN2 = 2;
+    static constexpr uint8_t MOTOR1_ENA = 14, MOTOR2_ENB = 12, TRIG_PIN = 13, ECHO_PIN = 15;
+    static constexpr uint8_t BASE_PIN = 16, SHOULDER_PIN = 3, ELBOW_PIN = 1, GRIPPER_PIN = 9;
+    static constexpr uint8_t MOTOR1_PWM_CH = 0, MOTOR2_PWM_CH = 1;  // unused by analogWrite
+    static constexpr uint8_t CORNER_LEFT_TRIG = NO_PIN, CORNER_LEFT_ECHO = NO_PIN;  // no pins left
+    static constexpr uint8_t CORNER_RIGHT_TRIG = NO_PIN, CORNER_RIGHT_ECHO = NO_PIN;
+    static constexpr uint8_t ENCODER_LEFT = NO_PIN, ENCODER_RIGHT = NO_PIN;
+};
+
+struct Esp32Pins {
+    static constexpr uint8_t MOTOR1_IN1 = 5, MOTOR1_IN2 = 4, MOTOR2_IN1 = 18, MOTOR2_IN2 = 19;
+    static constexpr uint8_t MOTOR1_ENA = 32, MOTOR2_ENB = 33, TRIG_PIN = 25, ECHO_PIN = 26;
+    static constexpr uint8_t BASE_PIN = 27, SHOULDER_PIN = 14, ELBOW_PIN = 12, GRIPPER_PIN = 13;
+    static constexpr uint8_t MOTOR1_PWM_CH = 14, MOTOR2_PWM_CH = 15;  // clear of the servo channels
+    static constexpr uint8_t CORNER_LEFT_TRIG = 21, CORNER_LEFT_ECHO = 22;
+    static constexpr uint8_t CORNER_RIGHT_TRIG = 23, CORNER_RIGHT_ECHO = 34;  // 34 is input-only
+    // Opt-in: 35 and 39 are input-only with no pull-ups and float when
+    // nothing is wired, so define WHEEL_ENCODERS only when encoders are fitted
+#if defined(WHEEL_ENCODERS)
+    static constexpr uint8_t ENCODER_LEFT = 35, ENCODER_RIGHT = 39;
+#else
+    static constexpr uint8_t ENCODER_LEFT = NO_PIN, ENCODER_RIGHT = NO_PIN;
+#endif
+};
+
+// Pins below FAST_GPIO_PINS can be driven with writeOutputs()
+#if defined(ESP32)
+    typedef Esp32Pins Pins;
+    typedef LedcPwm<25000, 10> MotorPwm;
+    constexpr uint8_t FAST_GPIO_PINS = 32;
+
+    inline void writeOutputs(uint32_t setMask, uint32_t clearMask) {
+        GPIO.out_w1tc = clearMask;
+        GPIO.out_w1ts = setMask;
+    }
+#elif defined(ESP8266)
+    typedef Esp8266Pins Pins;
+    typedef AnalogPwm MotorPwm;
+    constexpr uint8_t FAST_GPIO_PINS = 16;
+
+    inline void writeOutputs(uint32_t setMask, uint32_t clearMask) {
+        GPOC = clearMask;
+        GPOS = setMask;
+    }
+#else
+    typedef Esp8266Pins Pins;
+    typedef AnalogPwm MotorPwm;
+    constexpr uint8_t FAST_GPIO_PINS = 0;
+
+    inline void writeOutputs(uint32_t, uint32_t) {}
+#endif
+
+// ESP32 runs networking and the control loop on separate cores. Define
+// SINGLE_CORE_CONTROL to keep everything in loop() as on ESP8266.
+#if defined(ESP32) && !defined(SINGLE_CORE_CONTROL)
+    #define DUAL_CORE_CONTROL 1
+    constexpr uint8_t NETWORK_CORE = 0;  // shared with the WiFi stack
+    constexpr uint8_t CONTROL_CORE = 1;
+#else
+    #define DUAL_CORE_CONTROL 0
+#endif
+
+constexpr uint32_t pinMask(uint8_t pin) {
+    return pin < FAST_GPIO_PINS ? (1UL << pin) : 0;
+}
+
+} // namespace Board
+
+#endif
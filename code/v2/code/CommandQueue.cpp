@@ -0,0 +1,152 @@
+#include "CommandQueue.h"
+
+CommandQueue::CommandQueue()
+    : nextSequence(1), driveMark(0), armMark(0), jogMark(0),
+      maxDepth(0), accepted(0), dropped(0), coalesced(0), preemptions(0), flushed(0), lastLatencyUs(0), maxLatencyUs(0) {
+}
+
+// Commands that must never wait behind a running motion
+CommandQueue::Priority CommandQueue::classify(const char *text) {
+    if (strcmp(text, "st") == 0) return PRIORITY_SAFETY;
+    if (strcmp(text, "oa off") == 0) return PRIORITY_SAFETY;
+    if (strcmp(text, "a x") == 0 || strcmp(text, "a e") == 0) return PRIORITY_SAFETY;
+    if (text[0] == 'j' && text[1] != '\0' && text[2] == '0') return PRIORITY_SAFETY;  // jog release
+    return PRIORITY_NORMAL;
+}
+
+// Commands whose effect does not depend on how often they run. Running one
+// twice in a row is the same as running it once.
+bool CommandQueue::isIdempotent(const char *text) {
+    static const char *const exact[] = {"mv", "bk", "lt", "rt", "rl", "rr", "st", "oa on", "oa off", "a p", "a r"};
+    static const char *const prefixed[] = {"vel ", "spd ", "lease "};
+    for (const char *command : exact) {
+        if (strcmp(text, command) == 0) return true;
+    }
+    for (const char *prefix : prefixed) {
+        if (strncmp(text, prefix, strlen(prefix)) == 0) return true;
+    }
+    return text[0] == 'j' && text[1] != '\0' && (text[2] == '+' || text[2] == '-' || text[2] == '0');
+}
+
+// Commands that set the wheels moving
+bool CommandQueue::isDrive(const char *text) {
+    static const char *const exact[] = {"mv", "bk", "lt", "rt", "rl", "rr", "oa nav", "oa scan"};
+    static const char *const prefixed[] = {"vel ", "goto ", "oa wall"};
+    for (const char *command : exact) {
+        if (strcmp(text, command) == 0) return true;
+    }
+    for (const char *prefix : prefixed) {
+        if (strncmp(text, prefix, strlen(prefix)) == 0) return true;
+    }
+    return false;
+}
+
+// Joint steps, gripper, gestures, saved-position moves and jogs. "m pos N"
+// only saves and is not motion.
+bool CommandQueue::isArmMotion(const char *text) {
+    if (isJog(text)) return true;
+    if (text[0] != '\0' && strchr("bseg", text[0]) && text[1] == ' ') return true;
+    return text[0] == 'm' && text[1] == ' ' && strncmp(text, "m pos", 5) != 0;
+}
+
+// A jog that starts a joint moving; the release is a safety command
+bool CommandQueue::isJog(const char *text) {
+    return text[0] == 'j' && text[1] != '\0' && (text[2] == '+' || text[2] == '-');
+}
+
+// Wrap-safe "a was accepted before b"
+static bool before(uint32_t a, uint32_t b) {
+    return (int32_t)(a - b) < 0;
+}
+
+// Producer side
+bool CommandQueue::push(const char *text) {
+    QueuedCommand command;
+    strncpy(command.text, text, QueuedCommand::MAX_LENGTH - 1);
+    command.text[QueuedCommand::MAX_LENGTH - 1] = '\0';
+    command.enqueuedAt = micros();
+
+    bool safety = classify(command.text) == PRIORITY_SAFETY;
+
+    // A repeat of the newest pending command would only redo it. Only the
+    // last command accepted counts: with a stop in between, the older one
+    // may be flushed and the repeat has to run on its own. A command the
+    // control loop has already taken does not count either.
+    if (isIdempotent(command.text)) {
+        uint32_t last = nextSequence - 1;
+        auto same = [&](const QueuedCommand &pending) {
+            return pending.sequence == last && strcmp(pending.text, command.text) == 0;
+        };
+        if (safety ? safetyRing.newestMatches(same) : normalRing.newestMatches(same)) {
+            coalesced.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    command.sequence = nextSequence;
+    bool ok = safety ? safetyRing.push(command) : normalRing.push(command);
+    if (!ok) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    nextSequence++;
+
+    accepted.fetch_add(1, std::memory_order_relaxed);
+    uint32_t depth = safetyRing.size() + normalRing.size();
+    if (depth > maxDepth.load(std::memory_order_relaxed)) {
+        maxDepth.store(depth, std::memory_order_relaxed);
+    }
+    return true;
+}
+
+// Consumer side: drains safety commands before anything else, then skips
+// motion commands that a later stop has made stale
+bool CommandQueue::pop(QueuedCommand &command) {
+    if (safetyRing.pop(command)) {
+        if (strcmp(command.text, "st") == 0) {
+            driveMark = armMark = command.sequence;
+        } else if (strcmp(command.text, "oa off") == 0) {
+            driveMark = command.sequence;
+        } else if (command.text[0] == 'a') {
+            armMark = command.sequence;  // a x, a e
+        } else {
+            jogMark = command.sequence;  // stopJog releases every joint
+        }
+        uint32_t latency = micros() - command.enqueuedAt;
+        lastLatencyUs.store(latency, std::memory_order_relaxed);
+        if (latency > maxLatencyUs.load(std::memory_order_relaxed)) {
+            maxLatencyUs.store(latency, std::memory_order_relaxed);
+        }
+        preemptions.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    while (normalRing.pop(command)) {
+        const char *text = command.text;
+        if ((isDrive(text) && before(command.sequence, driveMark)) ||
+            (isArmMotion(text) && before(command.sequence, armMark)) ||
+            (isJog(text) && before(command.sequence, jogMark))) {
+            flushed.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        return true;
+    }
+    return false;
+}
+
+bool CommandQueue::hasSafetyPending() const {
+    return safetyRing.size() > 0;
+}
+
+CommandQueue::Stats CommandQueue::getStats() const {
+    Stats stats;
+    stats.depth = safetyRing.size() + normalRing.size();
+    stats.maxDepth = maxDepth.load(std::memory_order_relaxed);
+    stats.accepted = accepted.load(std::memory_order_relaxed);
+    stats.dropped = dropped.load(std::memory_order_relaxed);
+    stats.coalesced = coalesced.load(std::memory_order_relaxed);
+    stats.preemptions = preemptions.load(std::memory_order_relaxed);
+    stats.flushed = flushed.load(std::memory_order_relaxed);
+    stats.lastLatencyUs = lastLatencyUs.load(std::memory_order_relaxed);
+    stats.maxLatencyUs = maxLatencyUs.load(std::memory_order_relaxed);
+    return stats;
+}
@@ -0,0 +1,71 @@
+#ifndef COMMAND_QUEUE_H
+#define COMMAND_QUEUE_H
+
+#include <Arduino.h>
+#include <atomic>
+#include "CommandRing.h"
+
+struct QueuedCommand {
+    static const size_t MAX_LENGTH = 48;
+    char text[MAX_LENGTH];
+    uint32_t enqueuedAt;  // micros() when it was accepted
+    uint32_t sequence;    // acceptance order across both rings
+};
+
+// Bounded two-level command queue between the network side (single producer)
+// and the control loop (single consumer). Safety commands jump the queue,
+// and while one is pending any blocking motion is expected to abort. Once a
+// stop runs, the motion commands it stops that were accepted before it are
+// dropped unrun: st and oa off drop older drives (st also arm motion), a x
+// and a e older arm motion, a jog release older jogs. Settings always run.
+class CommandQueue {
+  public:
+    enum Priority : uint8_t {
+      PRIORITY_SAFETY,
+      PRIORITY_NORMAL
+    };
+
+    struct Stats {
+      uint32_t depth;
+      uint32_t maxDepth;
+      uint32_t accepted;
+      uint32_t dropped;
+      uint32_t coalesced;      // repeats merged into an identical pending command
+      uint32_t preemptions;
+      uint32_t flushed;        // motion commands dropped by a later stop
+      uint32_t lastLatencyUs;  // safety command enqueue -> execution
+      uint32_t maxLatencyUs;
+    };
+
+    CommandQueue();
+    bool push(const char *text);
+    bool pop(QueuedCommand &command);
+    bool hasSafetyPending() const;
+    Stats getStats() const;
+    static Priority classify(const char *text);
+    static bool isIdempotent(const char *text);
+    static bool isDrive(const char *text);
+    static bool isArmMotion(const char *text);
+    static bool isJog(const char *text);
+
+  private:
+    CommandRing<QueuedCommand, 4> safetyRing;
+    CommandRing<QueuedCommand, 16> normalRing;
+    uint32_t nextSequence;  // producer only
+    // Consumer only: commands of each kind accepted before its mark are stale
+    uint32_t driveMark;
+    uint32_t armMark;
+    uint32_t jogMark;
+
+    // Each counter has a single writer: producer or consumer
+    std::atomic<uint32_t> maxDepth;
+    std::atomic<uint32_t> accepted;
+    std::atomic<uint32_t> dropped;
+    std::atomic<uint32_t> coalesced;
+    std::atomic<uint32_t> preemptions;
+    std::atomic<uint32_t> flushed;
+    std::atomic<uint32_t> lastLatencyUs;
+    std::atomic<uint32_t> maxLatencyUs;
+};
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef COMMAND_RING_H
+#define COMMAND_RING_H
+
+#include <Arduino.h>
+#include <atomic>
+
+// Lock-free single-producer/single-consumer ring. The network side pushes,
+// the control loop pops; neither side ever blocks the other.
+template <class T, uint32_t N>
+class CommandRing {
+  private:
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "Ring size must be a power of two");
+
+    T slots[N];
+    std::atomic<uint32_t> head;  // next slot to write, owned by the producer
+    std::atomic<uint32_t> tail;  // next slot to read, owned by the consumer
+
+  public:
+    CommandRing() : head(0), tail(0) {}
+
+    bool push(const T &item) {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) >= N) return false;  // full
+        slots[h & (N - 1)] = item;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T &item) {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire)) return false;  // empty
+        item = slots[t & (N - 1)];
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Producer side: whether the most recently pushed item is still waiting
+    // and same(item) holds. The consumer may pop it while same() looks at
+    // it (the slot stays intact, only the producer rewrites it), so tail is
+    // checked again afterwards: true means it was not yet popped when the
+    // match was decided, and will run after this call.
+    template <class Same>
+    bool newestMatches(Same same) const {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) return false;
+        if (!same(slots[(h - 1) & (N - 1)])) return false;
+        return tail.load(std::memory_order_acquire) != h;
+    }
+
+    uint32_t size() const {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+
+    static constexpr uint32_t capacity() { return N; }
+};
+
+#endif
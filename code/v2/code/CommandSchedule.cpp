@@ -0,0 +1,51 @@
+#include "CommandSchedule.h"
+
+CommandSchedule::CommandSchedule() : count(0) {
+}
+
+// Inserts after any entry due at the same time, so ties keep their order
+bool CommandSchedule::add(const char *text, uint32_t dueAt) {
+    if (count >= CAPACITY) return false;
+
+    uint8_t index = count;
+    while (index > 0 && (int32_t)(entries[index - 1].dueAt - dueAt) > 0) {
+        entries[index] = entries[index - 1];
+        index--;
+    }
+    strncpy(entries[index].text, text, QueuedCommand::MAX_LENGTH - 1);
+    entries[index].text[QueuedCommand::MAX_LENGTH - 1] = '\0';
+    entries[index].dueAt = dueAt;
+    count++;
+    return true;
+}
+
+const char *CommandSchedule::due(uint32_t now) const {
+    if (count == 0 || (int32_t)(now - entries[0].dueAt) < 0) return NULL;
+    return entries[0].text;
+}
+
+void CommandSchedule::release() {
+    if (count == 0) return;
+    count--;
+    memmove(entries, entries + 1, count * sizeof(Entry));
+}
+
+void CommandSchedule::clear() {
+    count = 0;
+}
+
+// The last entry renews the lease once more as it goes in, so a batch that
+// does not end in st still stops a window after its last command
+uint8_t CommandSchedule::feed(CommandQueue &queue, DriveLease &lease) {
+    if (count == 0) return 0;
+    lease.renew();
+    uint32_t now = millis();
+    uint8_t moved = 0;
+    const char *text;
+    while ((text = due(now)) != NULL) {
+        if (!queue.push(text)) break;  // queue full: retry next pass
+        release();
+        moved++;
+    }
+    return moved;
+}
@@ -0,0 +1,36 @@
+#ifndef COMMAND_SCHEDULE_H
+#define COMMAND_SCHEDULE_H
+
+#include <Arduino.h>
+#include "CommandQueue.h"
+#include "DriveLease.h"
+
+// Commands waiting for a time to run, kept in due order. Owned by the
+// network side, which moves due entries into the CommandQueue; a full
+// queue just leaves them here for the next pass. While entries wait, the
+// batch is its own session and keeps the drive lease alive, so a timed
+// drive runs its full length; st clears the schedule and ends it.
+class CommandSchedule {
+  public:
+    static const uint8_t CAPACITY = 32;
+
+    CommandSchedule();
+    bool add(const char *text, uint32_t dueAt);
+    const char *due(uint32_t now) const;  // earliest entry if due, else NULL
+    void release();                       // drop the entry due() returned
+    void clear();
+    // Moves the due entries into queue and renews lease; returns how many
+    uint8_t feed(CommandQueue &queue, DriveLease &lease);
+    uint8_t size() const { return count; }
+
+  private:
+    struct Entry {
+      char text[QueuedCommand::MAX_LENGTH];
+      uint32_t dueAt;
+    };
+
+    Entry entries[CAPACITY];
+    uint8_t count;
+};
+
+#endif
@@ -0,0 +1,31 @@
+#include "DriveLease.h"
+
+DriveLease::DriveLease(uint32_t window) : window(window), expiry(0), held(false), expired(0) {
+}
+
+void DriveLease::renew() {
+    expiry.store(millis() + window.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+void DriveLease::setWindow(uint32_t ms) {
+    window.store(ms, std::memory_order_relaxed);
+    if (ms == 0) held = false;
+}
+
+void DriveLease::grant() {
+    renew();
+    held = window.load(std::memory_order_relaxed) != 0;
+}
+
+void DriveLease::release() {
+    held = false;
+}
+
+// One compare while nothing is driving
+bool DriveLease::expire() {
+    if (!held) return false;
+    if ((int32_t)(millis() - expiry.load(std::memory_order_relaxed)) < 0) return false;
+    held = false;
+    expired++;
+    return true;
+}
@@ -0,0 +1,34 @@
+#ifndef DRIVE_LEASE_H
+#define DRIVE_LEASE_H
+
+#include <Arduino.h>
+#include <atomic>
+
+// Deadman lease: a drive command keeps the wheels turning only while it is
+// renewed. Heartbeats and batches renew from the network side; the control
+// side grants, releases and enforces it.
+class DriveLease {
+  public:
+    explicit DriveLease(uint32_t window);
+
+    // Either side: push the deadline out one window
+    void renew();
+    uint32_t getWindow() const { return window.load(std::memory_order_relaxed); }
+
+    // Control side
+    void setWindow(uint32_t ms);  // 0 turns the lease off and releases it
+    void grant();    // a drive command takes the lease
+    void release();  // nothing left for it to guard
+    bool isHeld() const { return held; }
+    // True once when a held lease runs out; the caller stops the wheels
+    bool expire();
+    uint32_t getExpired() const { return expired; }
+
+  private:
+    std::atomic<uint32_t> window;  // ms, 0 = no lease
+    std::atomic<uint32_t> expiry;  // millis()
+    bool held;                     // control side only
+    uint32_t expired;              // control side only
+};
+
+#endif
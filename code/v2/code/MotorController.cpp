@@ -1,92 +1,301 @@
 #include "MotorController.h"
 
-MotorController::MotorController(uint8_t in1, uint8_t in2, uint8_t in3, uint8_t in4, uint8_t enA, uint8_t enB) {
-    in1Pin = in1;
-    in2Pin = in2;
-    in3Pin = in3;
-    in4Pin = in4;
-    enAPin = enA;
-    enBPin = enB;
-    currentSpeed = 200;
-}
-
-void MotorController::begin() {
-    pinMode(in1Pin, OUTPUT);
-    pinMode(in2Pin, OUTPUT);
-    pinMode(in3Pin, OUTPUT);
-    pinMode(in4Pin, OUTPUT);
-    pinMode(enAPin, OUTPUT);
-    pinMode(enBPin, OUTPUT);
-    stop();
-}
-
-void MotorController::moveForward() {
-    digitalWrite(in1Pin, HIGH);
-    digitalWrite(in2Pin, LOW);
-    digitalWrite(in3Pin, HIGH);
-    digitalWrite(in4Pin, LOW);
-    analogWrite(enAPin, currentSpeed);
-    analogWrite(enBPin, currentSpeed);
-}
-
-void MotorController::moveBackward() {
-    digitalWrite(in1Pin, LOW);
-    digitalWrite(in2Pin, HIGH);
-    digitalWrite(in3Pin, LOW);
-    digitalWrite(in4Pin, HIGH);
-    analogWrite(enAPin, currentSpeed);
-    analogWrite(enBPin, currentSpeed);
-}
-
-void MotorController::turnLeft() {
-    digitalWrite(in1Pin, HIGH);
-    digitalWrite(in2Pin, LOW);
-    digitalWrite(in3Pin, HIGH);
-    digitalWrite(in4Pin, LOW);
-    analogWrite(enAPin, currentSpeed / 2);
-    analogWrite(enBPin, currentSpeed);
-}
-
-void MotorController::turnRight() {
-    digitalWrite(in1Pin, HIGH);
-    digitalWrite(in2Pin, LOW);
-    digitalWrite(in3Pin, HIGH);
-    digitalWrite(in4Pin, LOW);
-    analogWrite(enAPin, currentSpeed);
-    analogWrite(enBPin, currentSpeed / 2);
-}
-
-void MotorController::rotateLeft() {
-    digitalWrite(in1Pin, LOW);
-    digitalWrite(in2Pin, HIGH);
-    digitalWrite(in3Pin, HIGH);
-    digitalWrite(in4Pin, LOW);
-    analogWrite(enAPin, currentSpeed);
-    analogWrite(enBPin, currentSpeed);
-}
-
-void MotorController::rotateRight() {
-    digitalWrite(in1Pin, HIGH);
-    digitalWrite(in2Pin, LOW);
-    digitalWrite(in3Pin, LOW);
-    digitalWrite(in4Pin, HIGH);
-    analogWrite(enAPin, currentSpeed);
-    analogWrite(enBPin, currentSpeed);
-}
-
-void MotorController::stop() {
-    digitalWrite(in1Pin, LOW);
-    digitalWrite(in2Pin, LOW);
-    digitalWrite(in3Pin, LOW);
-    digitalWrite(in4Pin, LOW);
-    analogWrite(enAPin, 0);
-    analogWrite(enBPin, 0);
-}
-
-void MotorController::setSpeed(int speed) {
-    currentSpeed = constrain(speed, 0, 255);
-}
-
-int MotorController::getSpeed() {
+#define VELOCITY_DEADBAND 0.02f  // Inputs below this are treated as zero
+
+template <class Pins, class Pwm>
+MotorController<Pins, Pwm>::MotorController() {
+    currentSpeed = fromByte(200);
+    minDuty = fromByte(50);
+    // 0 -> 200/255 in ~330ms, 200/255 -> 0 in ~170ms at any resolution
+    wheelA = {0, 0, fromByte(600), fromByte(1200), 0, -1, 0};
+    wheelB = {0, 0, fromByte(600), fromByte(1200), 0, -1, 0};
+    lastUpdateTime = 0;
+    dirState = 0xFF;  // Unknown, forces the first write
+    outputStats = {0, 0, 0, 0};
+    governor = 1.0f;
+}
+
+template <class Pins, class Pwm>
+void MotorController<Pins, Pwm>::begin() {
+    pinMode(Pins::MOTOR1_IN1, OUTPUT);
+    pinMode(Pins::MOTOR1_IN2, OUTPUT);
+    pinMode(Pins::MOTOR2_IN1, OUTPUT);
+    pinMode(Pins::MOTOR2_IN2, OUTPUT);
+    Pwm::attach(Pins::MOTOR1_ENA, Pins::MOTOR1_PWM_CH);
+    Pwm::attach(Pins::MOTOR2_ENB, Pins::MOTOR2_PWM_CH);
+    halt();
+}
+
+// Advances both wheels toward their targets, call this from loop()
+template <class Pins, class Pwm>
+void MotorController<Pins, Pwm>::update() {
+    unsigned long currentTime = millis();
+    unsigned long elapsed = currentTime - lastUpdateTime;
+    if (elapsed < UPDATE_INTERVAL) return;
+    lastUpdateTime = currentTime;
+
+    stepWheel(wheelA, governedTarget(wheelA), currentTime, elapsed);
+    stepWheel(wheelB, governedTarget(wheelB), currentTime, elapsed);
+    applyOutputs();
+}
+
+// The governor only slows forward driving: both wheels scale together, so
+// the turn ratio holds, and rotating in place or reversing is untouched.
+// A governed wheel keeps at least minDuty so the robot creeps, not stalls.
+template <class Pins, class Pwm>
+int MotorController<Pins, Pwm>::governedTarget(const Wheel &wheel) {
+    if (governor >= 1.0f || wheel.target <= 0) return wheel.target;
+    if (wheelA.target + wheelB.target <= 0) return wheel.target;
+    if (governor <= 0.0f) return 0;
+    int duty = (int)(wheel.target * governor + 0.5f);
+    return max(duty, min(minDuty, wheel.target));
+}
+
+template <class Pins, class Pwm>
+void MotorController<Pins, Pwm>::stepWheel(Wheel &wheel, int target, unsigned long now, unsigned long elapsed) {
+    if ((long)(wheel.coastUntil - now) > 0) return;  // still coasting
+    if (wheel.duty == target) return;
+
+    // A reversal first ramps down to zero and coasts before spinning up again
+    bool reversing = (wheel.duty > 0 && target < 0) || (wheel.duty < 0 && target > 0);
+    int goal = reversing ? 0 : target;
+    bool slowing = abs(goal) < abs(wheel.duty);
+    int rate = slowing ? wheel.decelRate : wheel.accelRate;
+
+    long step = (rate > 0) ? max(1L, (long)rate * (long)elapsed / 1000L) : 0xFFFFL;
+    if (goal > wheel.duty) {
+        wheel.duty = (int)min((long)goal, (long)wheel.duty + step);
+    } else {
+        wheel.duty = (int)max((long)goal, (long)wheel.duty - step);
+    }
+
+    if (reversing && wheel.duty == 0) {
+        wheel.coastUntil = now + COAST_TIME;
+    }
+}
+
+template <class Pins, class Pwm>
+void MotorController<Pins, Pwm>::applyOutputs() {
+    uint8_t state = 0;
+    if (wheelA.duty > 0) state |= DIR_IN1;
+    if (wheelA.duty < 0) state |= DIR_IN2;
+    if (wheelB.duty > 0) state |= DIR_IN3;
+    if (wheelB.duty < 0) state |= DIR_IN4;
+    writeDirection(state);
+    writeDuty(wheelA, Pins::MOTOR1_ENA, Pins::MOTOR1_PWM_CH);
+    writeDuty(wheelB, Pins::MOTOR2_ENB, Pins::MOTOR2_PWM_CH);
+}
+
+// A settled wheel keeps its duty, so most passes write nothing. Rewriting
+// an unchanged duty can restart the PWM period and glitch the output.
+template <class Pins, class Pwm>
+void MotorController<Pins, Pwm>::writeDuty(Wheel &wheel, uint8_t pin, uint8_t channel) {
+    int duty = outputDuty(wheel);
+    if (duty == wheel.written) {
+        outputStats.dutySkipped++;
+        return;
+    }
+    wheel.written = duty;
+    outputStats.dutyWrites++;
+    Pwm::write(pin, channel, duty);
+}
+
+// A trim never reverses a wheel or turns a stopped one
+template <class Pins, class Pwm>
+int MotorController<Pins, Pwm>::outputDuty(const Wheel &wheel) {
+    if (wheel.duty == 0) return 0;
+    return constrain(abs(wheel.duty) + wheel.trim, 0, Pwm::MAX_DUTY);
+}
+
+// Clears then sets in two back-to-back register writes, so the bridge only
+// ever passes through coast, never a half-updated drive state
+template <class Pins, class Pwm>
+void MotorController<Pins, Pwm>::writeDirection(uint8_t state) {
+    if (state == dirState) {
+        outputStats.directionSkipped++;
+        return;
+    }
+    dirState = state;
+    outputStats.directionWrites++;
+
+    if (FAST_DIRECTION) {
+        Board::writeOutputs(directionMask(state), directionMask(~state & 0x0F));
+    } else {
+        writeDirectionPins(state);
+    }
+}
+
+template <class Pins, class Pwm>
+void MotorController<Pins, Pwm>::writeDirectionPins(uint8_t state) {
+    digitalWrite(Pins::MOTOR1_IN1, (state & DIR_IN1) ? HIGH : LOW);
+    digitalWrite(Pins::MOTOR1_IN2, (state & DIR_IN2) ? HIGH : LOW);
+    digitalWrite(Pins::MOTOR2_IN1, (state & DIR_IN3) ? HIGH : LOW);
+    digitalWrite(Pins::MOTOR2_IN2, (state & DIR_IN4) ? HIGH : LOW);
+}
+
+template <class Pins, class Pwm>
+void MotorController<Pins, Pwm>::setTargets(int left, int right) {
+    wheelA.target = left;
+    wheelB.target = right;
+}
+
+// linear and angular are in -1..1, scaled to currentSpeed. Positive angular
+// turns left. When a wheel saturates both are scaled down together, so the
+// ratio of the wheel velocities is kept. The duties are not in that ratio:
+// velocityToDuty lifts both onto minDuty..currentSpeed, which brings the
+// slower wheel closer to the faster one.
+template <class Pins, class Pwm>
+void MotorController<Pins, Pwm>::setVelocity(float linear, float angular) {
+    linear = constrain(linear, -1.0f, 1.0f);
+    angular = constrain(angular, -1.0f, 1.0f);
+
+    float left = linear - angular;
+    float right = linear + angular;
+    float peak = max(fabsf(left), fabsf(right));
+    if (peak > 1.0f) {
+        left /= peak;
+        right /= peak;
+    }
+    setTargets(velocityToDuty(left), velocityToDuty(right));
+}
+
+// Maps |velocity| onto minDuty..currentSpeed so small inputs still move
+template <class Pins, class Pwm>
+int MotorController<Pins, Pwm>::velocityToDuty(float velocity) {
+    float magnitude = fabsf(velocity);
+    if (magnitude < VELOCITY_DEADBAND) return 0;
+
+    int floorDuty = min(minDuty, currentSpeed);
+    int duty = floorDuty + (int)(magnitude * (currentSpeed - floorDuty) + 0.5f);
+    return velocity < 0 ? -duty : duty;
+}
+
+// Drive presets
+template <class Pins, class Pwm>
+void MotorController<Pins, Pwm>::moveForward() {
+    setVelocity(1.0f, 0.0f);
+}
+
+template <class Pins, class Pwm>
+void MotorController<Pins, Pwm>::moveBackward() {
+    setVelocity(-1.0f, 0.0f);
+}
+
+template <class Pins, class Pwm>
+void MotorController<Pins, Pwm>::turnLeft() {
+    setVelocity(0.75f, 0.25f);   // left at half of right's velocity, 125/200 duty by default
+}
+
+template <class Pins, class Pwm>
+void MotorController<Pins, Pwm>::turnRight() {
+    setVelocity(0.75f, -0.25f);  // right at half of left's velocity, 125/200 duty by default
+}
+
+template <class Pins, class Pwm>
+void MotorController<Pins, Pwm>::rotateLeft() {
+    setVelocity(0.0f, 1.0f);
+}
+
+template <class Pins, class Pwm>
+void MotorController<Pins, Pwm>::rotateRight() {
+    setVelocity(0.0f, -1.0f);
+}
+
+// Ramps down to a stop using the configured deceleration
+template <class Pins, class Pwm>
+void MotorController<Pins, Pwm>::stop() {
+    setTargets(0, 0);
+}
+
+// Cuts both outputs immediately, bypassing the ramp
+template <class Pins, class Pwm>
+void MotorController<Pins, Pwm>::halt() {
+    wheelA.target = wheelA.duty = 0;
+    wheelB.target = wheelB.duty = 0;
+    wheelA.coastUntil = wheelB.coastUntil = 0;
+    wheelA.trim = wheelB.trim = 0;
+    applyOutputs();
+}
+
+template <class Pins, class Pwm>
+void MotorController<Pins, Pwm>::setSpeed(int speed) {
+    currentSpeed = constrain(speed, 0, Pwm::MAX_DUTY);
+}
+
+template <class Pins, class Pwm>
+int MotorController<Pins, Pwm>::getSpeed() {
     return currentSpeed;
-}
\ No newline at end of file
+}
+
+// Signed duty currently applied to a wheel
+template <class Pins, class Pwm>
+int MotorController<Pins, Pwm>::getDuty(uint8_t wheel) {
+    return (wheel == WHEEL_LEFT) ? wheelA.duty : wheelB.duty;
+}
+
+template <class Pins, class Pwm>
+void MotorController<Pins, Pwm>::setTrim(uint8_t wheel, int trim) {
+    Wheel &w = (wheel == WHEEL_LEFT) ? wheelA : wheelB;
+    w.trim = constrain(trim, -Pwm::MAX_DUTY, Pwm::MAX_DUTY);
+}
+
+template <class Pins, class Pwm>
+int MotorController<Pins, Pwm>::getTrim(uint8_t wheel) {
+    return (wheel == WHEEL_LEFT) ? wheelA.trim : wheelB.trim;
+}
+
+template <class Pins, class Pwm>
+void MotorController<Pins, Pwm>::setRamp(uint8_t wheel, int accel, int decel) {
+    Wheel &w = (wheel == WHEEL_LEFT) ? wheelA : wheelB;
+    w.accelRate = max(accel, 0);
+    w.decelRate = max(decel, 0);
+}
+
+template <class Pins, class Pwm>
+void MotorController<Pins, Pwm>::setDeadband(int duty) {
+    minDuty = constrain(duty, 0, Pwm::MAX_DUTY);
+}
+
+template <class Pins, class Pwm>
+void MotorController<Pins, Pwm>::setGovernor(float scale) {
+    governor = constrain(scale, 0.0f, 1.0f);
+}
+
+template <class Pins, class Pwm>
+bool MotorController<Pins, Pwm>::isSettled() {
+    return wheelA.duty == governedTarget(wheelA) && wheelB.duty == governedTarget(wheelB);
+}
+
+// Prints CPU cycles per drive-state change for the digitalWrite path and the
+// register path. Enables are held at 0, so the motors stay still.
+template <class Pins, class Pwm>
+void MotorController<Pins, Pwm>::benchmarkDirection(int iterations) {
+    const uint8_t forward = DIR_IN1 | DIR_IN3;
+    const uint8_t backward = DIR_IN2 | DIR_IN4;
+    if (iterations < 1) iterations = 1;
+    halt();
+
+    uint32_t start = ESP.getCycleCount();
+    for (int i = 0; i < iterations; i++) {
+        writeDirectionPins((i & 1) ? forward : backward);
+    }
+    uint32_t slowCycles = ESP.getCycleCount() - start;
+
+    start = ESP.getCycleCount();
+    for (int i = 0; i < iterations; i++) {
+        writeDirection((i & 1) ? forward : backward);
+    }
+    uint32_t fastCycles = ESP.getCycleCount() - start;
+
+    halt();
+    Serial.printf("Direction change: digitalWrite %lu cycles, %s %lu cycles\n",
+                  (unsigned long)(slowCycles / iterations),
+                  FAST_DIRECTION ? "register" : "fallback",
+                  (unsigned long)(fastCycles / iterations));
+}
+
+// Instantiated for the board selected in BoardConfig.h
+template class MotorController<Board::Pins, Board::MotorPwm>;
+#if defined(ARDUINO_HOST)
+template class MotorController<Board::Pins, LedcPwm<25000, 10>>;  // ESP32 duty mapping, for the host tests
+#endif
@@ -2,16 +2,81 @@
 #define MOTOR_CONTROLLER_H
 
 #include <Arduino.h>
+#include "BoardConfig.h"
 
+template <class Pins, class Pwm = Board::MotorPwm>
 class MotorController {
+  public:
+    // Output writes made and skipped because the value was unchanged
+    struct OutputStats {
+      uint32_t directionWrites;
+      uint32_t directionSkipped;
+      uint32_t dutyWrites;
+      uint32_t dutySkipped;
+    };
+
   private:
-    uint8_t in1Pin, in2Pin, in3Pin, in4Pin;
-    uint8_t enAPin, enBPin;
+    // Per-wheel ramp state, duty is signed (negative = reverse)
+    struct Wheel {
+      int target;
+      int duty;
+      int accelRate;              // duty units per second, 0 = no limit
+      int decelRate;              // duty units per second, 0 = no limit
+      unsigned long coastUntil;   // end of brake/coast phase on reversal
+      int written;                // duty last sent to the PWM, -1 = unknown
+      int trim;                   // added to |duty| on output, from the speed loop
+    };
+
+    // Direction pins as a 4-bit state (IN1..IN4)
+    static const uint8_t DIR_IN1 = 0x01;
+    static const uint8_t DIR_IN2 = 0x02;
+    static const uint8_t DIR_IN3 = 0x04;
+    static const uint8_t DIR_IN4 = 0x08;
+    static constexpr bool FAST_DIRECTION =
+        Pins::MOTOR1_IN1 < Board::FAST_GPIO_PINS && Pins::MOTOR1_IN2 < Board::FAST_GPIO_PINS &&
+        Pins::MOTOR2_IN1 < Board::FAST_GPIO_PINS && Pins::MOTOR2_IN2 < Board::FAST_GPIO_PINS;
+
+    static constexpr uint32_t directionMask(uint8_t state) {
+        return ((state & DIR_IN1) ? Board::pinMask(Pins::MOTOR1_IN1) : 0) |
+               ((state & DIR_IN2) ? Board::pinMask(Pins::MOTOR1_IN2) : 0) |
+               ((state & DIR_IN3) ? Board::pinMask(Pins::MOTOR2_IN1) : 0) |
+               ((state & DIR_IN4) ? Board::pinMask(Pins::MOTOR2_IN2) : 0);
+    }
+
+    // Converts an 8-bit duty to the backend's resolution
+    static constexpr int fromByte(int duty) {
+        return (int)((long)duty * Pwm::MAX_DUTY / 255);
+    }
+
     int currentSpeed;
-    
+    int minDuty;  // lowest duty that still turns a wheel
+    Wheel wheelA, wheelB;
+    unsigned long lastUpdateTime;
+    uint8_t dirState;
+    OutputStats outputStats;
+    float governor;  // 0..1 scale on forward targets, set by obstacle avoidance
+    const unsigned long UPDATE_INTERVAL = 10; // 10ms between ramp steps
+    const unsigned long COAST_TIME = 60;      // 60ms coast before reversing
+
+    void setTargets(int left, int right);
+    int velocityToDuty(float velocity);
+    int governedTarget(const Wheel &wheel);
+    void stepWheel(Wheel &wheel, int target, unsigned long now, unsigned long elapsed);
+    void applyOutputs();
+    void writeDirection(uint8_t state);
+    void writeDirectionPins(uint8_t state);
+    void writeDuty(Wheel &wheel, uint8_t pin, uint8_t channel);
+    static int outputDuty(const Wheel &wheel);
+
   public:
-    MotorController(uint8_t in1, uint8_t in2, uint8_t in3, uint8_t in4, uint8_t enA, uint8_t enB);
+    static const uint8_t WHEEL_LEFT = 0;  // Motor 1 (ENA)
+    static const uint8_t WHEEL_RIGHT = 1; // Motor 2 (ENB)
+    static constexpr int MAX_DUTY = Pwm::MAX_DUTY;
+
+    MotorController();
     void begin();
+    void update();
+    void setVelocity(float linear, float angular);
     void moveForward();
     void moveBackward();
     void turnLeft();
@@ -19,8 +84,23 @@ class MotorController {
     void rotateLeft();
     void rotateRight();
     void stop();
+    void halt();
     void setSpeed(int speed);
     int getSpeed();
+    int getDuty(uint8_t wheel);
+    // A closed speed loop corrects the ramped duty by this much, in the
+    // wheel's direction of travel; 0 drives it open loop
+    void setTrim(uint8_t wheel, int trim);
+    int getTrim(uint8_t wheel);
+    void setRamp(uint8_t wheel, int accel, int decel);
+    void setDeadband(int duty);
+    void setGovernor(float scale);
+    float getGovernor() { return governor; }
+    bool isSettled();
+    OutputStats getOutputStats() { return outputStats; }
+    void benchmarkDirection(int iterations);
 };
 
-#endif
\ No newline at end of file
+typedef MotorController<Board::Pins> BoardMotors;
+
+#endif
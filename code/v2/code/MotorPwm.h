@@ -0,0 +1,63 @@
+#ifndef MOTOR_PWM_H
+#define MOTOR_PWM_H
+
+#include <Arduino.h>
+
+// PWM backends for the motor enable pins. Each one exposes MAX_DUTY plus
+// attach()/write(), and MotorController works in its duty units.
+
+// Generic analogWrite path (ESP8266), 8-bit at the core's default frequency
+struct AnalogPwm {
+    static constexpr uint8_t RESOLUTION_BITS = 8;
+    static constexpr int MAX_DUTY = (1 << RESOLUTION_BITS) - 1;
+
+    static void attach(uint8_t pin, uint8_t channel) {
+        (void)channel;
+        pinMode(pin, OUTPUT);
+#if defined(ESP8266)
+        analogWriteRange(MAX_DUTY);  // core 2.x defaults to 1023
+#endif
+    }
+
+    static void write(uint8_t pin, uint8_t channel, int duty) {
+        (void)channel;
+        analogWrite(pin, duty);
+    }
+};
+
+// The host shim has the LEDC calls too, so its tests cover both backends
+#if defined(ESP32) || defined(ARDUINO_HOST)
+// ESP32 LEDC hardware PWM. Frequency * 2^Bits must fit the 80MHz APB clock,
+// e.g. 25kHz at 10 bits or 20kHz at 11 bits.
+template <uint32_t Frequency, uint8_t Bits>
+struct LedcPwm {
+    static_assert(Frequency >= 20000, "Keep motor PWM above the audible range");
+    static_assert(Bits >= 10 && Bits <= 12, "Use 10-12 bit resolution");
+    static_assert((Frequency << Bits) <= 80000000UL, "Frequency too high for this resolution");
+
+    static constexpr uint8_t RESOLUTION_BITS = Bits;
+    static constexpr int MAX_DUTY = (1 << Bits) - 1;
+
+    static void attach(uint8_t pin, uint8_t channel) {
+#if ESP_ARDUINO_VERSION_MAJOR >= 3
+        (void)channel;
+        ledcAttach(pin, Frequency, Bits);
+#else
+        ledcSetup(channel, Frequency, Bits);
+        ledcAttachPin(pin, channel);
+#endif
+    }
+
+    static void write(uint8_t pin, uint8_t channel, int duty) {
+#if ESP_ARDUINO_VERSION_MAJOR >= 3
+        (void)channel;
+        ledcWrite(pin, duty);
+#else
+        (void)pin;
+        ledcWrite(channel, duty);
+#endif
+    }
+};
+#endif
+
+#endif
@@ -1,17 +1,222 @@
 #include "ObstacleAvoidance.h"
 
-ObstacleAvoidance::ObstacleAvoidance(MotorController* m, UltrasonicSensor* s) {
+ObstacleAvoidance::ObstacleAvoidance(BoardMotors* m, BoardSensor* s)
+    : wallPid(0.03, 0.005, 0.01, 0.6) {
     motors = m;
     sensor = s;
     isEnabled = false;
+    isNavigating = false;
+    waitHook = NULL;
     stopDistance = 30.0;  // Stop if obstacle is closer than 30cm
     turnDistance = 50.0;  // Start turning if obstacle is closer than 50cm
     criticalDistance = 15.0; // Emergency stop and back up if closer than 15cm
-    lastCheckTime = 0;
+    checkPending = false;
+    for (uint8_t i = 0; i < 3; i++) {
+        thresholdIds[i] = -1;
+        near[i] = false;
+    }
+    closingSpeed = 0;
+    lastSampleDistance = 0;
+    lastSampleTime = 0;
+    brakeTime = 0.6;  // Stop if impact is predicted within 0.6s
+    turnTime = 1.2;   // Start turning if impact is predicted within 1.2s
+    navMode = NAV_RIGHT_TURN;
+    navState = NAV_DRIVE;
+    heading = 0;
+    lastHeadingTime = 0;
+    rotationRate = 180.0;  // Calibrate per robot with "oa rate"
+    scanOrigin = 0;
+    scanTime = 0;
+    targetHeading = 0;
+    wallTarget = 25.0;   // Follow at 25cm
+    wallAngle = 90.0;    // Sensor facing right
+    wallSpeed = 0.6;
+    wallDistance = 0;
+    wallSampleTime = 0;
+    lastWallTime = 0;
+    wallSampleReady = false;
+    array = NULL;
+    arrayRound = 0;
+    arrayTime = 0;
+    arrayClearance = BoardSensor::MAX_DISTANCE;
+    leftOpener = false;
+    samplingIdle = false;
 }
 
+// Subscribes to the sensor's shared sample stream instead of polling it
 void ObstacleAvoidance::begin() {
-    // Nothing to initialize
+    thresholdIds[BAND_TURN - 1] = sensor->subscribe(onDistance, this, turnDistance, HYSTERESIS);
+    thresholdIds[BAND_STOP - 1] = sensor->subscribe(onDistance, this, stopDistance, HYSTERESIS);
+    thresholdIds[BAND_CRITICAL - 1] = sensor->subscribe(onDistance, this, criticalDistance, HYSTERESIS);
+    sensor->subscribe(onDistance, this);  // every sample, for the closing speed
+}
+
+void ObstacleAvoidance::onDistance(void *context, int8_t id, DistanceEvent event, const DistanceSample &sample) {
+    ObstacleAvoidance *self = static_cast<ObstacleAvoidance *>(context);
+    if (event == DISTANCE_SAMPLE) {
+        self->checkPending = true;
+        self->trackClosingSpeed(sample);
+        self->updateGovernor(sample);
+        if (self->navState == NAV_SCANNING) self->recordScan(sample);
+        if (self->navMode == NAV_WALL) {
+            self->wallDistance = sample.distance * sinf(fabsf(self->wallAngle) * DEG_TO_RAD);
+            self->wallSampleTime = sample.time;
+            self->wallSampleReady = true;
+        }
+        return;
+    }
+    for (uint8_t i = 0; i < 3; i++) {
+        if (self->thresholdIds[i] == id) self->near[i] = (event == DISTANCE_NEAR);
+    }
+}
+
+// Smoothed rate of change of the distance. Readings with no echo, and gaps
+// long enough that the robot may have turned, restart the estimate. The
+// smoothing goes by elapsed time, so it holds as the sampling rate adapts.
+void ObstacleAvoidance::trackClosingSpeed(const DistanceSample &sample) {
+    unsigned long elapsed = sample.time - lastSampleTime;
+    bool valid = sample.distance < BoardSensor::MAX_DISTANCE;
+    if (valid && lastSampleTime != 0 && elapsed > 0 && elapsed <= MAX_SAMPLE_GAP) {
+        float rate = (lastSampleDistance - sample.distance) * 1000.0f / elapsed;
+        float weight = 1.0f - expf(-(elapsed / 1000.0f) / RATE_TIME_CONSTANT);
+        closingSpeed += weight * (rate - closingSpeed);
+    } else {
+        closingSpeed = 0;
+    }
+    lastSampleDistance = sample.distance;
+    lastSampleTime = valid ? sample.time : 0;
+}
+
+// Scales the allowed forward speed with distance instead of switching
+// between full speed and a maneuver. At a low speed setting the robot may
+// creep close to the critical distance; at full speed it starts slowing
+// GOVERNOR_SPAN further out and stops at stopDistance. A short predicted
+// time to collision slows it further.
+void ObstacleAvoidance::updateGovernor(const DistanceSample &sample) {
+    if (!isEnabled) return;
+    if (isNavigating && navMode == NAV_WALL) {
+        motors->setGovernor(1.0f);  // the sensor sees the wall, not the path
+        return;
+    }
+
+    float speedFactor = (float)motors->getSpeed() / BoardMotors::MAX_DUTY;
+    float slowFrom = turnDistance + GOVERNOR_SPAN * speedFactor;
+    float stopAt = criticalDistance + (stopDistance - criticalDistance) * speedFactor;
+    float distance = min(sample.distance, pathClearance());
+    float scale = (distance - stopAt) / (slowFrom - stopAt);
+
+    float ttc = getTimeToCollision();
+    if (ttc >= 0 && ttc < turnTime) {
+        scale = min(scale, (ttc - brakeTime) / (turnTime - brakeTime));
+    }
+    motors->setGovernor(scale);
+}
+
+// Seconds until the obstacle is reached at the current closing speed, or
+// a negative value when nothing is approaching
+float ObstacleAvoidance::getTimeToCollision() {
+    if (closingSpeed < MIN_CLOSING_SPEED) return -1;
+    return lastSampleDistance / closingSpeed;
+}
+
+// The distance band, raised when closing speed predicts an earlier impact.
+// At full speed the robot covers the stop band between two checks, so the
+// prediction starts braking before the distance alone would. Array returns
+// in the path count by distance alone.
+ObstacleAvoidance::Band ObstacleAvoidance::band() {
+    float clearance = pathClearance();
+    if (near[BAND_CRITICAL - 1] || clearance <= criticalDistance) return BAND_CRITICAL;
+
+    float ttc = getTimeToCollision();
+    if (near[BAND_STOP - 1] || clearance <= stopDistance || (ttc >= 0 && ttc < brakeTime)) return BAND_STOP;
+    if (near[BAND_TURN - 1] || clearance <= turnDistance || (ttc >= 0 && ttc < turnTime)) return BAND_TURN;
+    return BAND_CLEAR;
+}
+
+// Urgency runs from 0 to 1 with the larger wheel duty, with how far the
+// nearest obstacle is inside the governor's slow-down zone, and jumps to 1
+// on a short time to collision. Parked with navigation off, the sensor
+// idles and the array stops triggering.
+void ObstacleAvoidance::adaptSampling() {
+    int left = abs(motors->getDuty(BoardMotors::WHEEL_LEFT));
+    int right = abs(motors->getDuty(BoardMotors::WHEEL_RIGHT));
+    samplingIdle = left == 0 && right == 0 && !isNavigating;
+    if (array) array->setIdle(samplingIdle);
+    if (samplingIdle) {
+        sensor->setReadInterval(IDLE_INTERVAL);
+        return;
+    }
+
+    float urgency = (float)max(left, right) / BoardMotors::MAX_DUTY;
+    float slowFrom = turnDistance + GOVERNOR_SPAN;
+    float nearest = min(sensor->getLastSample().distance, pathClearance());
+    urgency = max(urgency, (slowFrom - nearest) / (slowFrom - criticalDistance));
+    float ttc = getTimeToCollision();
+    if (ttc >= 0 && ttc < turnTime) urgency = 1;
+    urgency = constrain(urgency, 0.0f, 1.0f);
+    sensor->setReadInterval(SLOW_INTERVAL - (unsigned long)((SLOW_INTERVAL - FAST_INTERVAL) * urgency));
+}
+
+void ObstacleAvoidance::setSensorArray(BoardSensorArray* a) {
+    array = a;
+    arrayRound = 0;
+    arrayTime = 0;
+}
+
+// Caches what band() and the turn direction need, once per array round
+void ObstacleAvoidance::readArray() {
+    if (!array || array->size() == 0) return;
+    BoardSensorArray::Snapshot snapshot = array->getSnapshot();
+    if (snapshot.round == arrayRound) return;
+    arrayRound = snapshot.round;
+    arrayTime = snapshot.time;
+    checkPending = true;
+
+    float clearance = BoardSensor::MAX_DISTANCE;
+    float left = BoardSensor::MAX_DISTANCE, right = BoardSensor::MAX_DISTANCE;
+    bool hasLeft = false, hasRight = false;
+    for (uint8_t i = 0; i < snapshot.count; i++) {
+        float d = snapshot.distance[i];
+        float angle = snapshot.angle[i] * DEG_TO_RAD;
+        if (snapshot.angle[i] > 0) {
+            left = min(left, d);
+            hasLeft = true;
+        } else if (snapshot.angle[i] < 0) {
+            right = min(right, d);
+            hasRight = true;
+        }
+        float ahead = d * cosf(angle);
+        if (d < BoardSensor::MAX_DISTANCE && ahead > 0 && fabsf(d * sinf(angle)) < PATH_HALF_WIDTH) {
+            clearance = min(clearance, ahead);
+        }
+    }
+    arrayClearance = clearance;
+    leftOpener = hasLeft && hasRight && left > right + SIDE_MARGIN;
+}
+
+bool ObstacleAvoidance::arrayFresh() {
+    return arrayTime != 0 && millis() - arrayTime <= ARRAY_MAX_AGE;
+}
+
+float ObstacleAvoidance::pathClearance() {
+    return arrayFresh() ? arrayClearance : BoardSensor::MAX_DISTANCE;
+}
+
+// Right unless a fresh array round shows more room on the left
+void ObstacleAvoidance::rotateAway() {
+    if (arrayFresh() && leftOpener) {
+        motors->rotateLeft();
+    } else {
+        motors->rotateRight();
+    }
+}
+
+void ObstacleAvoidance::turnAway() {
+    if (arrayFresh() && leftOpener) {
+        motors->turnLeft();
+    } else {
+        motors->turnRight();
+    }
 }
 
 void ObstacleAvoidance::enable() {
@@ -20,48 +225,110 @@ void ObstacleAvoidance::enable() {
 
 void ObstacleAvoidance::disable() {
     isEnabled = false;
+    stopNavigation();
+    motors->setGovernor(1.0f);
 }
 
 bool ObstacleAvoidance::isActive() {
     return isEnabled;
 }
 
+// Autonomous driving, advanced by update() from the control loop
+void ObstacleAvoidance::startNavigation(NavMode mode) {
+    isEnabled = true;
+    isNavigating = true;
+    navMode = mode;
+    navState = NAV_DRIVE;
+    scanTime = 0;
+    wallPid.reset();
+    wallSampleReady = false;
+}
+
+void ObstacleAvoidance::stopNavigation() {
+    if (!isNavigating) return;
+    isNavigating = false;
+    motors->stop();
+}
+
+bool ObstacleAvoidance::navigating() {
+    return isNavigating;
+}
+
+// The hook runs while a maneuver waits; returning true aborts the maneuver
+void ObstacleAvoidance::setWaitHook(bool (*hook)()) {
+    waitHook = hook;
+}
+
+// Sampling adapts even with OA off, so telemetry and alerts keep a reading
+// rate that suits the driving
+void ObstacleAvoidance::update() {
+    adaptSampling();
+    if (!isEnabled) return;
+    trackHeading();
+    readArray();
+    if (isNavigating) {
+        navigate();
+    } else {
+        check();
+    }
+}
+
+// Blocks like delay() but keeps the motor ramp and the sensor stream
+// advancing. Returns false if the wait hook asked to abort.
+bool ObstacleAvoidance::holdFor(unsigned long ms) {
+    unsigned long start = millis();
+    while (millis() - start < ms) {
+        motors->update();
+        adaptSampling();
+        sensor->update();
+        if (array) array->update();
+        trackHeading();
+        readArray();
+        if (waitHook && waitHook()) return false;
+        yield();
+    }
+    return true;
+}
+
+// The governor ramps from brake to turn, so the pair must keep that order
+bool ObstacleAvoidance::setTimeToCollision(float brake, float turn) {
+    if (!(brake > 0 && turn > brake)) return false;
+    brakeTime = brake;
+    turnTime = turn;
+    return true;
+}
+
 void ObstacleAvoidance::setDistances(float stop, float turn, float critical) {
     stopDistance = stop;
     turnDistance = turn;
     criticalDistance = critical;
+    sensor->setThreshold(thresholdIds[BAND_TURN - 1], turnDistance, HYSTERESIS);
+    sensor->setThreshold(thresholdIds[BAND_STOP - 1], stopDistance, HYSTERESIS);
+    sensor->setThreshold(thresholdIds[BAND_CRITICAL - 1], criticalDistance, HYSTERESIS);
 }
 
+// Runs once per new reading, so it keeps pace with the sampling rate
 bool ObstacleAvoidance::check() {
     if (!isEnabled) return true;
     
-    unsigned long currentTime = millis();
-    if (currentTime - lastCheckTime >= CHECK_INTERVAL) {
-        float distance = sensor->getFilteredDistance(3);
-        lastCheckTime = currentTime;
+    if (checkPending) {
+        Band current = band();
+        checkPending = false;
         
-        if (distance <= criticalDistance) {
-            motors->stop();
-            delay(100);
-            motors->moveBackward();
-            delay(500);
-            motors->rotateRight();
-            delay(750);
+        if (current == BAND_CRITICAL) {
             motors->stop();
-            return false;
-        }
-        else if (distance <= stopDistance) {
-            motors->stop();
-            delay(100);
-            motors->rotateRight();
-            delay(500);
+            if (holdFor(100)) {
+                motors->moveBackward();
+                if (holdFor(500)) {
+                    rotateAway();
+                    holdFor(750);
+                }
+            }
             motors->stop();
             return false;
         }
-        else if (distance <= turnDistance) {
-            motors->turnRight();
-            return true;
-        }
+        // Outside the critical band the speed governor slows forward
+        // driving, so the operator keeps control instead of being turned away
     }
     return true;
 }
@@ -69,29 +336,187 @@ bool ObstacleAvoidance::check() {
 void ObstacleAvoidance::navigate() {
     if (!isEnabled) return;
     
-    float distance = sensor->getFilteredDistance(3);
+    if (navMode == NAV_WALL) {
+        followWall();  // the distance bands describe the wall here
+        return;
+    }
+
+    Band current = band();
+    if (navMode == NAV_SCAN && current != BAND_CRITICAL) {
+        navigateScan(current);
+        return;
+    }
     
-    if (distance <= criticalDistance) {
+    if (current == BAND_CRITICAL) {
         // Emergency maneuver
         motors->stop();
-        delay(100);
+        if (!holdFor(100)) return;
         motors->moveBackward();
-        delay(1000);
-        motors->rotateRight();
-        delay(750);
+        if (!holdFor(1000)) return;
+        rotateAway();
+        holdFor(750);
     }
-    else if (distance <= stopDistance) {
+    else if (current == BAND_STOP) {
         // Find new path
         motors->stop();
-        delay(100);
-        motors->rotateRight();
-        delay(500);
+        if (!holdFor(100)) return;
+        rotateAway();
+        holdFor(500);
     }
-    else if (distance <= turnDistance) {
+    else if (current == BAND_TURN) {
         // Gentle turn
-        motors->turnRight();
+        turnAway();
     }
     else {
         motors->moveForward();
     }
-}
\ No newline at end of file
+}
+
+void ObstacleAvoidance::setRotationRate(float degreesPerSecond) {
+    rotationRate = degreesPerSecond;
+}
+
+// Integrates the turn rate implied by the wheel duties. Close enough to
+// aim a turn at a bin picked a few seconds earlier.
+void ObstacleAvoidance::trackHeading() {
+    unsigned long now = millis();
+    unsigned long elapsed = now - lastHeadingTime;
+    lastHeadingTime = now;
+    if (elapsed > 100) return;  // first call, or the loop stalled
+
+    int difference = motors->getDuty(BoardMotors::WHEEL_RIGHT) - motors->getDuty(BoardMotors::WHEEL_LEFT);
+    heading += rotationRate * difference / (2.0f * BoardMotors::MAX_DUTY) * elapsed / 1000.0f;
+}
+
+// Bin of an absolute heading in the last sweep. The sweep turns clockwise,
+// so bins count clockwise from where it began.
+int8_t ObstacleAvoidance::scanBin(float absoluteHeading) {
+    float swept = fmodf(scanOrigin - absoluteHeading, 360.0f);
+    if (swept < 0) swept += 360.0f;
+    return (int8_t)(swept * SCAN_BINS / 360.0f) % SCAN_BINS;
+}
+
+void ObstacleAvoidance::recordScan(const DistanceSample &sample) {
+    int8_t bin = scanBin(heading);
+    scanBins[bin] = min(scanBins[bin], sample.distance);
+    if (scanCounts[bin] < 255) scanCounts[bin]++;
+}
+
+bool ObstacleAvoidance::binOpen(uint8_t bin) {
+    return scanCounts[bin] > 0 && scanBins[bin] > turnDistance;
+}
+
+// Polar-histogram choice in the style of VFH: the centre of the widest run
+// of open bins. With no open bin it takes the deepest one.
+float ObstacleAvoidance::pickHeading() {
+    uint8_t bestStart = 0;
+    uint8_t bestLength = 0;
+    for (uint8_t start = 0; start < SCAN_BINS; start++) {
+        if (!binOpen(start)) continue;
+        if (binOpen((start + SCAN_BINS - 1) % SCAN_BINS) && bestLength > 0) continue;  // inside a run
+        uint8_t length = 0;
+        while (length < SCAN_BINS && binOpen((start + length) % SCAN_BINS)) length++;
+        if (length > bestLength) {
+            bestLength = length;
+            bestStart = start;
+        }
+    }
+
+    float centre;
+    if (bestLength > 0) {
+        centre = bestStart + bestLength / 2.0f;
+    } else {
+        uint8_t deepest = 0;
+        for (uint8_t bin = 1; bin < SCAN_BINS; bin++) {
+            if (scanBins[bin] > scanBins[deepest]) deepest = bin;
+        }
+        centre = deepest + 0.5f;
+    }
+    return scanOrigin - centre * 360.0f / SCAN_BINS;
+}
+
+// Non-blocking: each call advances drive, sweep or turn by one step. A
+// sweep younger than SCAN_CACHE_TIME is reused, with the heading that just
+// got blocked marked closed, so a second stop does not rescan.
+void ObstacleAvoidance::navigateScan(Band current) {
+    switch (navState) {
+        case NAV_DRIVE:
+            if (current < BAND_STOP) {
+                motors->moveForward();
+                return;
+            }
+            if (scanTime != 0 && millis() - scanTime < SCAN_CACHE_TIME) {
+                scanBins[scanBin(heading)] = lastSampleDistance;
+                targetHeading = pickHeading();
+                navState = NAV_TURNING;
+                return;
+            }
+            for (uint8_t bin = 0; bin < SCAN_BINS; bin++) {
+                scanBins[bin] = BoardSensor::MAX_DISTANCE;
+                scanCounts[bin] = 0;
+            }
+            scanOrigin = heading;
+            navState = NAV_SCANNING;
+            motors->rotateRight();
+            return;
+
+        case NAV_SCANNING:
+            if (scanOrigin - heading < 360.0f) {
+                motors->rotateRight();
+                return;
+            }
+            scanTime = millis();
+            targetHeading = pickHeading();
+            navState = NAV_TURNING;
+            return;
+
+        case NAV_TURNING: {
+            float error = fmodf(targetHeading - heading, 360.0f);
+            if (error > 180.0f) error -= 360.0f;
+            if (error < -180.0f) error += 360.0f;
+            if (fabsf(error) <= HEADING_TOLERANCE) {
+                navState = NAV_DRIVE;
+                motors->moveForward();
+            } else if (error > 0) {
+                motors->rotateLeft();
+            } else {
+                motors->rotateRight();
+            }
+            return;
+        }
+    }
+}
+
+// target in cm, speed 0..1, angle of the sensor from straight ahead
+void ObstacleAvoidance::setWallFollowing(float target, float speed, float angle) {
+    if (target > 0) wallTarget = target;
+    if (speed > 0) wallSpeed = constrain(speed, 0.0f, 1.0f);
+    if (angle != 0) wallAngle = constrain(angle, -90.0f, 90.0f);
+    wallPid.reset();
+}
+
+void ObstacleAvoidance::setWallGains(float kp, float ki, float kd) {
+    wallPid.setGains(kp, ki, kd);
+    wallPid.reset();
+}
+
+// Steers once per new sample: the PID turns the distance error into an
+// angular command, positive error (too close) steering away from the wall.
+// A lost wall is searched for by curving toward its side.
+void ObstacleAvoidance::followWall() {
+    if (!wallSampleReady) return;
+    wallSampleReady = false;
+
+    float side = wallAngle > 0 ? 1.0f : -1.0f;
+    unsigned long elapsed = wallSampleTime - lastWallTime;
+    lastWallTime = wallSampleTime;
+    if (elapsed > WALL_MAX_GAP) wallPid.reset();
+
+    if (wallDistance > wallTarget * WALL_LOST) {
+        wallPid.reset();
+        motors->setVelocity(wallSpeed * 0.5f, -side * WALL_SEARCH_TURN);
+        return;
+    }
+    float correction = wallPid.update(wallTarget, wallDistance, elapsed / 1000.0f);
+    motors->setVelocity(wallSpeed, side * correction);
+}
@@ -3,27 +3,159 @@
 
 #include "MotorController.h"
 #include "UltrasonicSensor.h"
+#include "SensorArray.h"
+#include "PidController.h"
 
 class ObstacleAvoidance {
+  public:
+    // Nearest distance band the last samples put the robot in
+    enum Band : uint8_t {
+      BAND_CLEAR,
+      BAND_TURN,
+      BAND_STOP,
+      BAND_CRITICAL
+    };
+
+    // How navigation picks a new direction when blocked
+    enum NavMode : uint8_t {
+      NAV_RIGHT_TURN,  // rotate right, or toward the open side when the array can tell
+      NAV_SCAN,        // sweep a full turn, take the widest open heading
+      NAV_WALL         // hold a distance to a wall beside the robot
+    };
+
+    static const uint8_t SCAN_BINS = 12;  // 30 degrees each
+
   private:
-    MotorController* motors;
-    UltrasonicSensor* sensor;
+    enum NavState : uint8_t {
+      NAV_DRIVE,
+      NAV_SCANNING,
+      NAV_TURNING
+    };
+
+    BoardMotors* motors;
+    BoardSensor* sensor;
     bool isEnabled;
+    bool isNavigating;
     float stopDistance;
     float turnDistance;
     float criticalDistance;
-    unsigned long lastCheckTime;
-    const unsigned long CHECK_INTERVAL = 100; // 100ms between checks
-    
+    bool checkPending;          // a sample or array round arrived since check() ran
+    const float HYSTERESIS = 5.0;             // cm past a threshold before it clears
+    bool (*waitHook)();
+
+    // Fed by sensor threshold events; index = band - 1
+    int8_t thresholdIds[3];
+    bool near[3];
+
+    // Time to collision, from the rate the distance shrinks between samples
+    float closingSpeed;         // cm/s, positive when approaching
+    float lastSampleDistance;
+    unsigned long lastSampleTime;
+    float brakeTime;            // s; predicted impact sooner than this stops
+    float turnTime;             // s; sooner than this starts turning
+    const float RATE_TIME_CONSTANT = 0.14;  // s; weights a sample 50ms on at 0.3
+    const float MIN_CLOSING_SPEED = 5.0;    // cm/s, below this is noise
+    const unsigned long MAX_SAMPLE_GAP = 200; // ms; longer gaps restart the estimate
+
+    // Speed governor: forward speed fades out between these distances,
+    // which move outward as the speed setting rises
+    const float GOVERNOR_SPAN = 60.0;       // cm added to turnDistance at full speed
+
+    // Sweep scan: heading is dead-reckoned from wheel duty, so it is only
+    // good for relative turns over a few seconds
+    NavMode navMode;
+    NavState navState;
+    float heading;              // degrees, counter-clockwise positive
+    unsigned long lastHeadingTime;
+    float rotationRate;         // deg/s spinning in place at full duty
+    float scanOrigin;           // heading when the sweep began
+    float scanBins[SCAN_BINS];  // nearest return per bin, cm; bin 0 = straight ahead
+    uint8_t scanCounts[SCAN_BINS];
+    unsigned long scanTime;     // when the last sweep finished, 0 = none
+    float targetHeading;
+    const unsigned long SCAN_CACHE_TIME = 2000; // ms a sweep is reused for
+    const float HEADING_TOLERANCE = 10.0;       // degrees
+
+    // Wall following: the sensor has to look sideways, wallAngle degrees
+    // from straight ahead (positive = wall on the right)
+    PidController wallPid;
+    float wallTarget;           // cm from the wall
+    float wallAngle;
+    float wallSpeed;            // forward command, 0..1
+    float wallDistance;         // perpendicular estimate from the last sample, cm
+    unsigned long wallSampleTime;
+    unsigned long lastWallTime;
+    bool wallSampleReady;
+    const float WALL_LOST = 3.0;            // x target: beyond this the wall is lost
+    const float WALL_SEARCH_TURN = 0.3;     // angular command while looking for it
+    const unsigned long WALL_MAX_GAP = 500; // ms; longer gaps restart the PID
+
+    // Adaptive sampling: the sensor reads faster the faster the wheels turn
+    // and the nearer the obstacle, and slows to IDLE_INTERVAL when parked
+    bool samplingIdle;
+    const unsigned long IDLE_INTERVAL = 250;  // ms between readings, parked
+    const unsigned long SLOW_INTERVAL = 80;   // creeping with the path clear
+    const unsigned long FAST_INTERVAL = 40;   // full duty, or an obstacle close
+
+    // Sensor array: returns near the robot's path count as obstacles ahead,
+    // and the side with more room picks the turn direction
+    BoardSensorArray* array;
+    uint32_t arrayRound;
+    unsigned long arrayTime;    // when the cached round completed, 0 = none
+    float arrayClearance;       // nearest in-path return, as a distance ahead, cm
+    bool leftOpener;            // the left sensors see more room than the right
+    const float PATH_HALF_WIDTH = 12.0;      // cm either side of the centreline
+    const float SIDE_MARGIN = 10.0;          // cm more room needed to prefer the left
+    const unsigned long ARRAY_MAX_AGE = 500; // ms; older rounds are ignored
+
+    void adaptSampling();
+    void readArray();
+    bool arrayFresh();
+    float pathClearance();
+    void rotateAway();
+    void turnAway();
+    void trackClosingSpeed(const DistanceSample &sample);
+    void updateGovernor(const DistanceSample &sample);
+    void trackHeading();
+    void recordScan(const DistanceSample &sample);
+    int8_t scanBin(float absoluteHeading);
+    bool binOpen(uint8_t bin);
+    float pickHeading();
+    void navigateScan(Band current);
+    void followWall();
+
+    bool holdFor(unsigned long ms);
+    static void onDistance(void *context, int8_t id, DistanceEvent event, const DistanceSample &sample);
+
   public:
-    ObstacleAvoidance(MotorController* m, UltrasonicSensor* s);
+    ObstacleAvoidance(BoardMotors* m, BoardSensor* s);
     void begin();
     void enable();
     void disable();
     bool isActive();
+    void startNavigation(NavMode mode = NAV_RIGHT_TURN);
+    void stopNavigation();
+    bool navigating();
+    void setWaitHook(bool (*hook)());
+    void setSensorArray(BoardSensorArray* a);
+    void update();
     void setDistances(float stop, float turn, float critical);
+    bool setTimeToCollision(float brake, float turn);  // false unless 0 < brake < turn
+    float getTimeToCollision();
+    void setRotationRate(float degreesPerSecond);
+    void setWallFollowing(float target, float speed, float angle);
+    void setWallGains(float kp, float ki, float kd);
+    float getWallDistance() { return wallDistance; }
+    float getWallTarget() { return wallTarget; }
+    float getWallSpeed() { return wallSpeed; }
+    float getWallAngle() { return wallAngle; }
+    float getRotationRate() { return rotationRate; }
+    float getHeading() { return heading; }
+    bool isSamplingIdle() { return samplingIdle; }
+    NavMode getNavMode() { return navMode; }
     bool check();
     void navigate();
+    Band band();
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,127 @@
+#include "Odometry.h"
+
+// sin(i * 90 / 64 degrees) in Q15
+static const int16_t QUARTER_SINE[65] = {
+    0, 804, 1608, 2410, 3212, 4011, 4808, 5602, 6393, 7179, 7962,
+    8739, 9512, 10278, 11039, 11793, 12539, 13279, 14010, 14732, 15446, 16151,
+    16846, 17530, 18204, 18868, 19519, 20159, 20787, 21403, 22005, 22594, 23170,
+    23731, 24279, 24811, 25329, 25832, 26319, 26790, 27245, 27683, 28105, 28510,
+    28898, 29268, 29621, 29956, 30273, 30571, 30852, 31113, 31356, 31580, 31785,
+    31971, 32137, 32285, 32412, 32521, 32609, 32678, 32728, 32757, 32767,
+};
+
+Odometry::Odometry(BoardMotors* m, BoardEncoders* e) {
+    motors = m;
+    encoders = e;
+    // A small TT-motor robot; calibrate per robot with "odo cal"
+    calibration.maxSpeed = 400;
+    calibration.wheelBase = 140;
+    calibration.stallDuty = BoardMotors::MAX_DUTY * 40 / 255;
+    calibration.lag = 80;
+    calibration.tickLength = 5400;  // 20-slot disc on a 65mm wheel
+    pose = {0, 0, 0};
+    lastStep = 0;
+    recalibrate();
+}
+
+void Odometry::begin() {
+    reset();
+}
+
+void Odometry::reset(float x, float y, float heading) {
+    pose = {fromCm(x), fromCm(y), fromDegrees(heading)};
+    wheelTravel[0] = wheelTravel[1] = 0;
+    for (uint8_t wheel = 0; wheel < 2; wheel++) {
+        lastTicks[wheel] = usingEncoders() ? encoders->getTicks(wheel) : 0;
+    }
+    lastStep = millis();
+    published.write(pose);
+}
+
+void Odometry::setCalibration(const Calibration &c) {
+    calibration = c;
+    calibration.wheelBase = max(calibration.wheelBase, (int32_t)1);
+    calibration.stallDuty = constrain(calibration.stallDuty, (int32_t)0, (int32_t)BoardMotors::MAX_DUTY - 1);
+    calibration.lag = max(calibration.lag, (int32_t)0);
+    recalibrate();
+}
+
+// The float work happens here, once per calibration, not per step
+void Odometry::recalibrate() {
+    int32_t span = BoardMotors::MAX_DUTY - calibration.stallDuty;
+    travelScale = ((int64_t)calibration.maxSpeed * STEP << 16) / span;
+    turnScale = (int64_t)(281474976710656.0 / (2 * M_PI * calibration.wheelBase * 1000.0));  // 2^48
+    lagWeight = (int32_t)((STEP << 16) / (calibration.lag + STEP));
+}
+
+// Integrates every whole STEP since the last call, so a loop that stalled
+// in a blocking maneuver catches up at the duty it left running
+void Odometry::update() {
+    unsigned long now = millis();
+    if (usingEncoders()) {
+        encoders->setDirection(BoardMotors::WHEEL_LEFT, motors->getDuty(BoardMotors::WHEEL_LEFT));
+        encoders->setDirection(BoardMotors::WHEEL_RIGHT, motors->getDuty(BoardMotors::WHEEL_RIGHT));
+    }
+    if (now - lastStep < STEP) return;
+
+    while (now - lastStep >= STEP) {
+        lastStep += STEP;
+        int32_t left = modelTravel(BoardMotors::WHEEL_LEFT);
+        int32_t right = modelTravel(BoardMotors::WHEEL_RIGHT);
+        if (usingEncoders()) {
+            integrate(encoderTravel(BoardMotors::WHEEL_LEFT), encoderTravel(BoardMotors::WHEEL_RIGHT));
+        } else {
+            integrate(left, right);
+        }
+    }
+    published.write(pose);
+}
+
+// um in one step, Q8
+int32_t Odometry::modelTravel(uint8_t wheel) {
+    int duty = motors->getDuty(wheel);
+    int32_t above = abs(duty) - calibration.stallDuty;
+    int32_t target = above > 0 ? (int32_t)((above * travelScale) >> 8) : 0;
+    if (duty < 0) target = -target;
+    wheelTravel[wheel] += (int32_t)(((int64_t)(target - wheelTravel[wheel]) * lagWeight) >> 16);
+    return wheelTravel[wheel];
+}
+
+// Ticks since the last step, um Q8. The first step after a catch-up takes
+// them all; later ones read zero.
+int32_t Odometry::encoderTravel(uint8_t wheel) {
+    int32_t ticks = encoders->getTicks(wheel);
+    int32_t delta = ticks - lastTicks[wheel];
+    lastTicks[wheel] = ticks;
+    return delta * calibration.tickLength * 256;
+}
+
+// Midpoint rule: the step's translation goes along the heading halfway
+// through its turn
+void Odometry::integrate(int32_t left, int32_t right) {
+    int32_t turn = (int32_t)(((int64_t)(right - left) * turnScale) >> 24);
+    uint32_t middle = pose.theta + (uint32_t)(turn / 2);
+    int64_t forward = ((int64_t)left + right) / 2;
+    pose.x += (int32_t)((forward * cosine(middle)) >> 23);
+    pose.y += (int32_t)((forward * sine(middle)) >> 23);
+    pose.theta += (uint32_t)turn;
+}
+
+uint32_t Odometry::fromDegrees(float degrees) {
+    degrees = fmodf(degrees, 360.0f);
+    if (degrees < 0) degrees += 360.0f;
+    return (uint32_t)(uint64_t)(degrees * (4294967296.0 / 360.0));
+}
+
+// Quarter-wave table with linear interpolation, good to about 2e-4
+int32_t Odometry::sine(uint32_t theta) {
+    uint32_t quadrant = theta >> 30;
+    uint32_t within = theta & 0x3FFFFFFFu;
+    if (quadrant & 1) within = 0x40000000u - within;
+    uint32_t index = within >> 24;
+    int32_t fraction = (within >> 8) & 0xFFFF;
+    int32_t a = QUARTER_SINE[index];
+    int32_t b = index < 64 ? QUARTER_SINE[index + 1] : a;
+    int32_t value = a + (((b - a) * fraction) >> 16);
+    return (quadrant & 2) ? -value : value;
+}
@@ -0,0 +1,70 @@
+#ifndef ODOMETRY_H
+#define ODOMETRY_H
+
+#include "MotorController.h"
+#include "WheelEncoders.h"
+#include "Seqlock.h"
+
+// Dead-reckoned pose, integrated every STEP in fixed point: position in um,
+// heading as a binary angle where 2^32 is one turn, so it wraps by itself.
+// Wheel travel comes from the encoders when they are fitted, otherwise from
+// each wheel's duty through a calibrated model: nothing below the stall
+// duty, a linear rise to maxSpeed at full duty, and a first-order lag.
+class Odometry {
+  public:
+    struct Pose {
+      int32_t x;          // um
+      int32_t y;          // um
+      uint32_t theta;     // binary angle, 0 = +x, counter-clockwise
+    };
+
+    struct Calibration {
+      int32_t maxSpeed;   // mm/s of a wheel at full duty
+      int32_t wheelBase;  // mm between the wheels
+      int32_t stallDuty;  // duty below which a wheel does not turn, of MAX_DUTY
+      int32_t lag;        // ms, motor time constant
+      int32_t tickLength; // um of travel per encoder tick
+    };
+
+    static const unsigned long STEP = 10;  // ms
+
+  private:
+    BoardMotors* motors;
+    BoardEncoders* encoders;
+    Calibration calibration;
+    Pose pose;
+    Seqlock<Pose> published;
+    int64_t travelScale;      // um per step per duty above the stall, Q16
+    int64_t turnScale;        // binary angle per um of wheel difference, Q16
+    int32_t lagWeight;        // share of the gap the model closes per step, Q16
+    int32_t wheelTravel[2];   // modelled um per step, Q8
+    int32_t lastTicks[2];
+    unsigned long lastStep;
+
+    void recalibrate();
+    int32_t modelTravel(uint8_t wheel);
+    int32_t encoderTravel(uint8_t wheel);
+    void integrate(int32_t left, int32_t right);
+
+  public:
+    Odometry(BoardMotors* m, BoardEncoders* e = NULL);
+    void begin();
+    void update();
+    void reset(float x = 0, float y = 0, float heading = 0);  // cm, cm, degrees
+    void setCalibration(const Calibration &c);
+    Calibration getCalibration() { return calibration; }
+    bool usingEncoders() { return encoders && encoders->isPresent(); }
+    // What the model expects of a wheel at its current duty, mm/s. It runs
+    // with encoders too, as the wheel speed loop's setpoint.
+    float getModelSpeed(uint8_t wheel) { return wheelTravel[wheel] / (256.0f * STEP); }
+    Pose getPose() const { return published.read(); }  // either side
+
+    static float toCm(int32_t um) { return um / 10000.0f; }
+    static int32_t fromCm(float cm) { return (int32_t)lroundf(cm * 10000.0f); }
+    static float toDegrees(uint32_t theta) { return (int32_t)theta * (180.0f / 2147483648.0f); }
+    static uint32_t fromDegrees(float degrees);
+    static int32_t sine(uint32_t theta);  // Q15
+    static int32_t cosine(uint32_t theta) { return sine(theta + 0x40000000u); }
+};
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef PID_CONTROLLER_H
+#define PID_CONTROLLER_H
+
+#include <Arduino.h>
+
+// Small PID with the derivative taken on the measurement, so a setpoint
+// change does not kick the output, and the integral clamped to the output
+// limit so it cannot wind up while the output saturates.
+class PidController {
+  private:
+    float kp, ki, kd;
+    float limit;
+    float integral;
+    float lastMeasurement;
+    bool primed;
+
+  public:
+    PidController(float p, float i, float d, float outputLimit)
+        : kp(p), ki(i), kd(d), limit(outputLimit), integral(0), lastMeasurement(0), primed(false) {}
+
+    void setGains(float p, float i, float d) {
+        kp = p;
+        ki = i;
+        kd = d;
+    }
+
+    void reset() {
+        integral = 0;
+        primed = false;
+    }
+
+    // dt in seconds
+    float update(float setpoint, float measurement, float dt) {
+        float error = setpoint - measurement;
+        float derivative = 0;
+        if (primed && dt > 0) {
+            derivative = -(measurement - lastMeasurement) / dt;
+            integral = constrain(integral + ki * error * dt, -limit, limit);
+        }
+        lastMeasurement = measurement;
+        primed = true;
+        return constrain(kp * error + integral + kd * derivative, -limit, limit);
+    }
+
+    float getKp() const { return kp; }
+    float getKi() const { return ki; }
+    float getKd() const { return kd; }
+};
+
+#endif
@@ -1,181 +1,352 @@
 // RobotArm.cpp
 #include "RobotArm.h"
 
-RobotArm::RobotArm(int bPin, int sPin, int ePin, int gPin) {
-  basePin = bPin;
-  shoulderPin = sPin;
-  elbowPin = ePin;
-  gripperPin = gPin;
-
-  baseAngle = HOME_BASE;
-  shoulderAngle = HOME_SHOULDER;
-  elbowAngle = HOME_ELBOW;
-  gripperAngle = HOME_GRIPPER;
+// The four home moves, for use inside gesture step lists
+#define ARM_HOME_STEPS \
+  {ARM_BASE, HOME_BASE}, {ARM_SHOULDER, HOME_SHOULDER}, \
+  {ARM_ELBOW, HOME_ELBOW}, {ARM_GRIPPER, HOME_GRIPPER}
+
+template <class Pins>
+RobotArm<Pins>::RobotArm() {
+  angles[ARM_BASE] = HOME_BASE;
+  angles[ARM_SHOULDER] = HOME_SHOULDER;
+  angles[ARM_ELBOW] = HOME_ELBOW;
+  angles[ARM_GRIPPER] = HOME_GRIPPER;
+
+  jobLength = 0;
+  jobIndex = 0;
+  jobState = JOB_IDLE;
+  waitTicks = 0;
+  lastTickTime = 0;
+
+  jogActive = false;
+  jogJoint = ARM_BASE;
+  jogVelocity = 0;
+  jogAccumulator = 0;
+  jogStartTime = 0;
 
   commandCount = 0;
   recording = false;
+  waitHook = NULL;
 }
 
-void RobotArm::begin() {
-  baseServo.attach(basePin);
-  shoulderServo.attach(shoulderPin);
-  elbowServo.attach(elbowPin);
-  gripperServo.attach(gripperPin);
+template <class Pins>
+void RobotArm<Pins>::begin() {
+  servos[ARM_BASE].attach(Pins::BASE_PIN);
+  servos[ARM_SHOULDER].attach(Pins::SHOULDER_PIN);
+  servos[ARM_ELBOW].attach(Pins::ELBOW_PIN);
+  servos[ARM_GRIPPER].attach(Pins::GRIPPER_PIN);
+  for (int i = 0; i < ARM_JOINT_COUNT; i++) {
+    servos[i].write(angles[i]);
+  }
 
   loadPositionsFromEEPROM();
   moveToHome();
 }
 
-void RobotArm::moveJoint(char joint, char direction) {
-  switch (joint) {
-    case 'b':
-      moveServo(baseServo, direction, &baseAngle);
-      break;
-    case 's':
-      moveServo(shoulderServo, direction, &shoulderAngle);
-      break;
-    case 'e':
-      moveServo(elbowServo, direction, &elbowAngle);
-      break;
+// Interpolation tick: moves the active joint one degree, or counts down a
+// wait step. Call this from the control loop.
+template <class Pins>
+void RobotArm<Pins>::update() {
+  if (jobState != JOB_RUNNING && !jogActive) return;
+
+  unsigned long currentTime = millis();
+  unsigned long elapsed = currentTime - lastTickTime;
+  if (elapsed < MOVE_INTERVAL) return;
+  lastTickTime = currentTime;
+
+  if (jogActive) {
+    updateJog(currentTime, elapsed);
+    return;
+  }
+
+  while (jobIndex < jobLength) {
+    const ArmStep &step = job[jobIndex];
+
+    if (step.joint == ARM_WAIT) {
+      if (waitTicks > 0) {
+        waitTicks--;
+        return;
+      }
+      jobIndex++;
+    } else {
+      int target = constrain((int)step.value, MIN_ANGLE, MAX_ANGLE);
+      int &angle = angles[step.joint];
+      if (angle != target) {
+        angle += (target > angle) ? 1 : -1;
+        servos[step.joint].write(angle);
+        return;
+      }
+      jobIndex++;
+    }
+
+    // Entering a wait step arms its countdown
+    if (jobIndex < jobLength && job[jobIndex].joint == ARM_WAIT) {
+      waitTicks = job[jobIndex].value / MOVE_INTERVAL;
+    }
   }
+  jobState = JOB_IDLE;
 }
 
-void RobotArm::moveGripper(char action) {
-  int targetAngle;
-  if (action == 'o') {
-    targetAngle = GRIPPER_OPEN;
-    Serial.println("Gripper opened");
+// Replaces any running job. Motion starts from the current angles.
+template <class Pins>
+void RobotArm<Pins>::startJob(const ArmStep *steps, uint8_t count) {
+  stopJog();
+  jobLength = min((int)count, (int)MAX_JOB_STEPS);
+  for (uint8_t i = 0; i < jobLength; i++) {
+    job[i] = steps[i];
   }
-  else if (action == 'c') {
-    targetAngle = GRIPPER_CLOSE;
-    Serial.println("Gripper closed");
+  jobIndex = 0;
+  waitTicks = (jobLength > 0 && job[0].joint == ARM_WAIT) ? job[0].value / MOVE_INTERVAL : 0;
+  jobState = jobLength > 0 ? JOB_RUNNING : JOB_IDLE;
+}
+
+template <class Pins>
+void RobotArm<Pins>::startMove(uint8_t joint, int targetAngle) {
+  const ArmStep step = {joint, (int16_t)constrain(targetAngle, MIN_ANGLE, MAX_ANGLE)};
+  startJob(&step, 1);
+}
+
+// Holds the current angles until resume()
+template <class Pins>
+void RobotArm<Pins>::pause() {
+  if (jobState == JOB_RUNNING) jobState = JOB_PAUSED;
+}
+
+template <class Pins>
+void RobotArm<Pins>::resume() {
+  if (jobState == JOB_PAUSED) jobState = JOB_RUNNING;
+}
+
+// Hold stops on the angle already written. Ease decelerates instead: the
+// joint in motion runs EASE_DEGREES more, each degree a tick slower than
+// the last (100, 50, 33 deg/s), then stops.
+template <class Pins>
+void RobotArm<Pins>::abort(bool ease) {
+  stopJog();
+  if (jobState == JOB_IDLE) return;
+
+  if (ease && jobIndex < jobLength && job[jobIndex].joint != ARM_WAIT) {
+    uint8_t joint = job[jobIndex].joint;
+    int target = constrain((int)job[jobIndex].value, MIN_ANGLE, MAX_ANGLE);
+    int angle = angles[joint];
+    int direction = (target > angle) ? 1 : -1;
+    int degrees = min(abs(target - angle), (int)EASE_DEGREES);
+    if (degrees > 0) {
+      ArmStep steps[2 * EASE_DEGREES];
+      uint8_t count = 0;
+      for (int i = 1; i <= degrees; i++) {
+        if (i > 1) steps[count++] = {ARM_WAIT, (int16_t)((i - 1) * MOVE_INTERVAL)};
+        steps[count++] = {joint, (int16_t)(angle + i * direction)};
+      }
+      startJob(steps, count);
+      Serial.println("Arm job easing to a stop");
+      return;
+    }
   }
-  else {
-    return;  // Invalid action
+
+  jobState = JOB_IDLE;
+  jobLength = 0;
+  jobIndex = 0;
+  Serial.println("Arm job aborted");
+}
+
+// Starts (or retargets) a jog. Any running job is dropped at its current
+// angle. A velocity of 0 stops the jog.
+template <class Pins>
+void RobotArm<Pins>::jog(uint8_t joint, int velocity) {
+  if (joint >= ARM_JOINT_COUNT) return;
+  if (velocity == 0) {
+    stopJog();
+    return;
+  }
+
+  jobState = JOB_IDLE;
+  jobLength = 0;
+  if (!jogActive || jogJoint != joint) {
+    jogAccumulator = 0;
+    lastTickTime = millis();
   }
+  jogActive = true;
+  jogJoint = joint;
+  jogVelocity = constrain(velocity, -MAX_JOG_SPEED, MAX_JOG_SPEED);
+  jogStartTime = millis();  // a repeated press renews the timeout
+}
 
-  // Use smooth movement for gripper
-  moveToAngle(gripperServo, &gripperAngle, targetAngle);
+template <class Pins>
+void RobotArm<Pins>::stopJog() {
+  jogActive = false;
+  jogVelocity = 0;
+  jogAccumulator = 0;
 }
 
-void RobotArm::moveServo(Servo &servo, char direction, int *currentAngle) {
-  int newAngle = *currentAngle;
-  int targetAngle;
+template <class Pins>
+void RobotArm<Pins>::updateJog(unsigned long now, unsigned long elapsed) {
+  if (now - jogStartTime >= JOG_TIMEOUT) {
+    stopJog();
+    Serial.println("Jog timed out");
+    return;
+  }
 
-  if (direction == '+') {
-    targetAngle = min(newAngle + STEP_ANGLE, MAX_ANGLE);
+  // deg/s * ms = millidegrees; whole degrees are written, the rest carries
+  jogAccumulator += (long)jogVelocity * (long)min(elapsed, 4 * MOVE_INTERVAL);
+  int degrees = jogAccumulator / 1000;
+  if (degrees == 0) return;
+  jogAccumulator -= (long)degrees * 1000;
+
+  int &angle = angles[jogJoint];
+  int target = constrain(angle + degrees, MIN_ANGLE, MAX_ANGLE);
+  if (target != angle) {
+    angle = target;
+    servos[jogJoint].write(angle);
   }
-  else if (direction == '-') {
-    targetAngle = max(newAngle - STEP_ANGLE, MIN_ANGLE);
+  if (angle == MIN_ANGLE || angle == MAX_ANGLE) {
+    stopJog();  // hit the end stop
   }
-  else {
-    return; // Invalid direction
+}
+
+template <class Pins>
+void RobotArm<Pins>::moveJoint(char joint, char direction) {
+  uint8_t index;
+  switch (joint) {
+    case 'b': index = ARM_BASE; break;
+    case 's': index = ARM_SHOULDER; break;
+    case 'e': index = ARM_ELBOW; break;
+    default: return;
   }
 
-  // Smooth movement by gradually changing angle
-  if (targetAngle != *currentAngle) {
-    int increment = (targetAngle > *currentAngle) ? 1 : -1;
-    
-    while (*currentAngle != targetAngle) {
-      *currentAngle += increment;
-      servo.write(*currentAngle);
-      
-      // Adjust delay for smoother movement
-      // Lower delay = faster movement, higher delay = slower, smoother movement
-      delay(10);  // Reduced from previous 15ms 
-    }
+  if (direction == '+') {
+    startMove(index, angles[index] + STEP_ANGLE);
+  }
+  else if (direction == '-') {
+    startMove(index, angles[index] - STEP_ANGLE);
   }
 }
 
-void RobotArm::moveToAngle(Servo &servo, int *currentAngle, int targetAngle) {
-  targetAngle = constrain(targetAngle, MIN_ANGLE, MAX_ANGLE);
-  
-  if (targetAngle != *currentAngle) {
-    int increment = (targetAngle > *currentAngle) ? 1 : -1;
-    
-    while (*currentAngle != targetAngle) {
-      *currentAngle += increment;
-      servo.write(*currentAngle);
-      
-      // Consistent smooth movement across all methods
-      delay(10);  // Same smooth movement delay as in moveServo
-    }
+template <class Pins>
+void RobotArm<Pins>::moveGripper(char action) {
+  if (action == 'o') {
+    startMove(ARM_GRIPPER, GRIPPER_OPEN);
+    Serial.println("Gripper opening");
+  }
+  else if (action == 'c') {
+    startMove(ARM_GRIPPER, GRIPPER_CLOSE);
+    Serial.println("Gripper closing");
   }
 }
 
-void RobotArm::moveToHome() {
-  moveToAngle(baseServo, &baseAngle, HOME_BASE);
-  moveToAngle(shoulderServo, &shoulderAngle, HOME_SHOULDER);
-  moveToAngle(elbowServo, &elbowAngle, HOME_ELBOW);
-  moveToAngle(gripperServo, &gripperAngle, HOME_GRIPPER);
-  Serial.println("Moved to home position");
+// Waits without a job, used by command playback. Returns false as soon as
+// the wait hook asks to stop.
+template <class Pins>
+bool RobotArm<Pins>::waitFor(unsigned long ms) {
+  unsigned long start = millis();
+  do {
+    if (waitHook && waitHook()) return false;
+    delay(1);
+  } while (millis() - start < ms);
+  return true;
 }
 
-// Predefined movements
-void RobotArm::performScan() {
-  moveToHome();
-  for (int angle = 0; angle <= 180; angle += 45) {
-    moveToAngle(baseServo, &baseAngle, angle);
-    delay(500);
-  }
-  moveToAngle(baseServo, &baseAngle, HOME_BASE);
+template <class Pins>
+void RobotArm<Pins>::setWaitHook(bool (*hook)()) {
+  waitHook = hook;
 }
 
-void RobotArm::performPick() {
-  moveToAngle(gripperServo, &gripperAngle, GRIPPER_OPEN);
-  moveToAngle(shoulderServo, &shoulderAngle, 45);
-  moveToAngle(elbowServo, &elbowAngle, 45);
-  moveToAngle(gripperServo, &gripperAngle, GRIPPER_CLOSE);
-  moveToAngle(shoulderServo, &shoulderAngle, 90);
-  moveToAngle(elbowServo, &elbowAngle, 90);
+template <class Pins>
+void RobotArm<Pins>::moveToHome() {
+  const ArmStep steps[] = { ARM_HOME_STEPS };
+  startJob(steps, sizeof(steps) / sizeof(steps[0]));
+  Serial.println("Moving to home position");
 }
 
-void RobotArm::performDrop() {
-  moveToAngle(baseServo, &baseAngle, 180);
-  moveToAngle(shoulderServo, &shoulderAngle, 45);
-  moveToAngle(elbowServo, &elbowAngle, 45);
-  moveToAngle(gripperServo, &gripperAngle, GRIPPER_OPEN);
-  moveToHome();
+// Predefined movements, one joint at a time
+template <class Pins>
+void RobotArm<Pins>::performScan() {
+  const ArmStep steps[] = {
+    ARM_HOME_STEPS,
+    {ARM_BASE, 0}, {ARM_WAIT, 500},
+    {ARM_BASE, 45}, {ARM_WAIT, 500},
+    {ARM_BASE, 90}, {ARM_WAIT, 500},
+    {ARM_BASE, 135}, {ARM_WAIT, 500},
+    {ARM_BASE, 180}, {ARM_WAIT, 500},
+    {ARM_BASE, HOME_BASE}
+  };
+  startJob(steps, sizeof(steps) / sizeof(steps[0]));
 }
 
-void RobotArm::performWave() {
-  moveToAngle(baseServo, &baseAngle, 90);
-  moveToAngle(shoulderServo, &shoulderAngle, 45);
-  moveToAngle(elbowServo, &elbowAngle, 0);
+template <class Pins>
+void RobotArm<Pins>::performPick() {
+  const ArmStep steps[] = {
+    {ARM_GRIPPER, GRIPPER_OPEN},
+    {ARM_SHOULDER, 45},
+    {ARM_ELBOW, 45},
+    {ARM_GRIPPER, GRIPPER_CLOSE},
+    {ARM_SHOULDER, 90},
+    {ARM_ELBOW, 90}
+  };
+  startJob(steps, sizeof(steps) / sizeof(steps[0]));
+}
 
-  for (int i = 0; i < 3; i++) {
-    moveToAngle(elbowServo, &elbowAngle, 45);
-    moveToAngle(elbowServo, &elbowAngle, 0);
-  }
+template <class Pins>
+void RobotArm<Pins>::performDrop() {
+  const ArmStep steps[] = {
+    {ARM_BASE, 180},
+    {ARM_SHOULDER, 45},
+    {ARM_ELBOW, 45},
+    {ARM_GRIPPER, GRIPPER_OPEN},
+    ARM_HOME_STEPS
+  };
+  startJob(steps, sizeof(steps) / sizeof(steps[0]));
+}
 
-  moveToHome();
+template <class Pins>
+void RobotArm<Pins>::performWave() {
+  const ArmStep steps[] = {
+    {ARM_BASE, 90},
+    {ARM_SHOULDER, 45},
+    {ARM_ELBOW, 0},
+    {ARM_ELBOW, 45}, {ARM_ELBOW, 0},
+    {ARM_ELBOW, 45}, {ARM_ELBOW, 0},
+    {ARM_ELBOW, 45}, {ARM_ELBOW, 0},
+    ARM_HOME_STEPS
+  };
+  startJob(steps, sizeof(steps) / sizeof(steps[0]));
 }
 
-void RobotArm::performBow() {
-  moveToHome();
-  moveToAngle(shoulderServo, &shoulderAngle, 60);
-  moveToAngle(elbowServo, &elbowAngle, 30);
-  delay(1000);
-  moveToAngle(shoulderServo, &shoulderAngle, 0);
-  moveToAngle(elbowServo, &elbowAngle, 0);
-  moveToHome();
+template <class Pins>
+void RobotArm<Pins>::performBow() {
+  const ArmStep steps[] = {
+    ARM_HOME_STEPS,
+    {ARM_SHOULDER, 60},
+    {ARM_ELBOW, 30},
+    {ARM_WAIT, 1000},
+    {ARM_SHOULDER, 0},
+    {ARM_ELBOW, 0},
+    ARM_HOME_STEPS
+  };
+  startJob(steps, sizeof(steps) / sizeof(steps[0]));
 }
 
-void RobotArm::performReach() {
-  moveToHome();
-  moveToAngle(shoulderServo, &shoulderAngle, 180);
-  moveToAngle(elbowServo, &elbowAngle, 135);
-  delay(1000);
-  moveToAngle(gripperServo, &gripperAngle, GRIPPER_CLOSE);
-  delay(500);
-  moveToHome();
+template <class Pins>
+void RobotArm<Pins>::performReach() {
+  const ArmStep steps[] = {
+    ARM_HOME_STEPS,
+    {ARM_SHOULDER, 180},
+    {ARM_ELBOW, 135},
+    {ARM_WAIT, 1000},
+    {ARM_GRIPPER, GRIPPER_CLOSE},
+    {ARM_WAIT, 500},
+    ARM_HOME_STEPS
+  };
+  startJob(steps, sizeof(steps) / sizeof(steps[0]));
 }
 
 // Position memory
-void RobotArm::saveCurrentPosition(int posNum) {
+template <class Pins>
+void RobotArm<Pins>::saveCurrentPosition(int posNum) {
   if (posNum >= 1 && posNum <= 3) {
     int index = posNum - 1;
-    savedPositions[index] = {baseAngle, shoulderAngle, elbowAngle, gripperAngle};
+    savedPositions[index] = {angles[ARM_BASE], angles[ARM_SHOULDER], angles[ARM_ELBOW], angles[ARM_GRIPPER]};
     positionUsed[index] = true;
     savePositionsToEEPROM();
     Serial.println("Position " + String(posNum) + " saved");
@@ -184,16 +355,20 @@ void RobotArm::saveCurrentPosition(int posNum) {
   }
 }
 
-void RobotArm::executeSavedPosition(int posNum) {
+template <class Pins>
+void RobotArm<Pins>::executeSavedPosition(int posNum) {
   if (posNum >= 1 && posNum <= 3) {
     int index = posNum - 1;
     if (positionUsed[index]) {
       Position pos = savedPositions[index];
-      moveToAngle(baseServo, &baseAngle, pos.base);
-      moveToAngle(shoulderServo, &shoulderAngle, pos.shoulder);
-      moveToAngle(elbowServo, &elbowAngle, pos.elbow);
-      moveToAngle(gripperServo, &gripperAngle, pos.gripper);
-      Serial.println("Moved to saved position " + String(posNum));
+      const ArmStep steps[] = {
+        {ARM_BASE, (int16_t)pos.base},
+        {ARM_SHOULDER, (int16_t)pos.shoulder},
+        {ARM_ELBOW, (int16_t)pos.elbow},
+        {ARM_GRIPPER, (int16_t)pos.gripper}
+      };
+      startJob(steps, sizeof(steps) / sizeof(steps[0]));
+      Serial.println("Moving to saved position " + String(posNum));
     } else {
       Serial.println("Position " + String(posNum) + " not yet saved");
     }
@@ -201,18 +376,21 @@ void RobotArm::executeSavedPosition(int posNum) {
 }
 
 // Command recording
-void RobotArm::startRecording() {
+template <class Pins>
+void RobotArm<Pins>::startRecording() {
   recording = true;
   commandCount = 0;
   Serial.println("Recording started");
 }
 
-void RobotArm::stopRecording() {
+template <class Pins>
+void RobotArm<Pins>::stopRecording() {
   recording = false;
   Serial.println("Recording stopped. Total commands: " + String(commandCount));
 }
 
-void RobotArm::processRecordedCommand(String command) {
+template <class Pins>
+void RobotArm<Pins>::processRecordedCommand(String command) {
   if (commandCount < MAX_COMMANDS) {
     recordedCommands[commandCount++] = command;
     Serial.println("Command recorded: " + command);
@@ -221,23 +399,26 @@ void RobotArm::processRecordedCommand(String command) {
   }
 }
 
-void RobotArm::executeRecordedCommands() {
+template <class Pins>
+void RobotArm<Pins>::executeRecordedCommands() {
   Serial.println("Executing recorded commands...");
   for (int i = 0; i < commandCount; i++) {
     Serial.println("Executing: " + recordedCommands[i]);
     // Command processing logic will be handled in main sketch
-    delay(500);
+    waitFor(500);
   }
   Serial.println("Execution completed");
 }
 
-void RobotArm::clearRecordedCommands() {
+template <class Pins>
+void RobotArm<Pins>::clearRecordedCommands() {
   commandCount = 0;
   Serial.println("Recorded commands cleared");
 }
 
 // EEPROM operations
-void RobotArm::savePositionsToEEPROM() {
+template <class Pins>
+void RobotArm<Pins>::savePositionsToEEPROM() {
   for (int i = 0; i < 3; i++) {
     int addr = i * sizeof(Position);
     EEPROM.put(addr, savedPositions[i]);
@@ -245,7 +426,8 @@ void RobotArm::savePositionsToEEPROM() {
   }
 }
 
-void RobotArm::loadPositionsFromEEPROM() {
+template <class Pins>
+void RobotArm<Pins>::loadPositionsFromEEPROM() {
   for (int i = 0; i < 3; i++) {
     int addr = i * sizeof(Position);
     EEPROM.get(addr, savedPositions[i]);
@@ -253,16 +435,18 @@ void RobotArm::loadPositionsFromEEPROM() {
   }
 }
 
-void RobotArm::printCurrentAngles() {
+template <class Pins>
+void RobotArm<Pins>::printCurrentAngles() {
   Serial.println("\nCurrent angles:");
-  Serial.print("Base: "); Serial.println(baseAngle);
-  Serial.print("Shoulder: "); Serial.println(shoulderAngle);
-  Serial.print("Elbow: "); Serial.println(elbowAngle);
-  Serial.print("Gripper: "); Serial.print(gripperAngle);
-  Serial.println(gripperAngle == GRIPPER_OPEN ? " (Open)" : " (Closed)");
+  Serial.print("Base: "); Serial.println(angles[ARM_BASE]);
+  Serial.print("Shoulder: "); Serial.println(angles[ARM_SHOULDER]);
+  Serial.print("Elbow: "); Serial.println(angles[ARM_ELBOW]);
+  Serial.print("Gripper: "); Serial.print(angles[ARM_GRIPPER]);
+  Serial.println(angles[ARM_GRIPPER] == GRIPPER_OPEN ? " (Open)" : " (Closed)");
 }
 
-void RobotArm::printSavedPositions() {
+template <class Pins>
+void RobotArm<Pins>::printSavedPositions() {
   Serial.println("\nSaved Positions:");
   for (int i = 0; i < 3; i++) {
     if (positionUsed[i]) {
@@ -276,3 +460,6 @@ void RobotArm::printSavedPositions() {
     }
   }
 }
+
+// Instantiated for the board selected in BoardConfig.h
+template class RobotArm<Board::Pins>;
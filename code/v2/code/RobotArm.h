@@ -5,11 +5,35 @@
 #include <Arduino.h>
 #include <Servo.h>
 #include <EEPROM.h>
+#include "BoardConfig.h"
 
+enum ArmJoint : uint8_t {
+  ARM_BASE,
+  ARM_SHOULDER,
+  ARM_ELBOW,
+  ARM_GRIPPER,
+  ARM_JOINT_COUNT,
+  ARM_WAIT = 0xFF  // ArmStep that pauses instead of moving
+};
+
+// One step of an arm job: move one joint to an angle, or wait
+struct ArmStep {
+  uint8_t joint;   // ArmJoint
+  int16_t value;   // target angle, or wait time in ms
+};
+
+template <class Pins>
 class RobotArm {
   public:
-    RobotArm(int basePin, int shoulderPin, int elbowPin, int gripperPin);
+    enum JobState : uint8_t {
+      JOB_IDLE,
+      JOB_RUNNING,
+      JOB_PAUSED
+    };
+
+    RobotArm();
     void begin();
+    void update();
 
     // Basic movement controls
     void moveJoint(char joint, char direction);
@@ -24,6 +48,18 @@ class RobotArm {
     void performBow();
     void performReach();
 
+    // Job control: every movement above runs as a job advanced by update()
+    void pause();
+    void resume();
+    void abort(bool ease = false);
+    JobState getJobState() { return jobState; }
+    bool isBusy() { return jobState != JOB_IDLE || jogActive; }
+
+    // Jog: continuous motion of one joint until stopJog() or the timeout
+    void jog(uint8_t joint, int velocity);
+    void stopJog();
+    bool isJogging() { return jogActive; }
+
     // Position memory
     void saveCurrentPosition(int posNum);
     void executeSavedPosition(int posNum);
@@ -40,24 +76,12 @@ class RobotArm {
     // Status
     void printCurrentAngles();
 
+    // Called while a blocking wait runs; returning true cuts the wait short
+    void setWaitHook(bool (*hook)());
+
   private:
-    // Servo objects
-    Servo baseServo;
-    Servo shoulderServo;
-    Servo elbowServo;
-    Servo gripperServo;
-
-    // Current angles
-    int baseAngle;
-    int shoulderAngle;
-    int elbowAngle;
-    int gripperAngle;
-
-    // Pins
-    int basePin;
-    int shoulderPin;
-    int elbowPin;
-    int gripperPin;
+    Servo servos[ARM_JOINT_COUNT];
+    int angles[ARM_JOINT_COUNT];
 
     // Constants
     static const int STEP_ANGLE = 15;
@@ -70,6 +94,26 @@ class RobotArm {
     static const int HOME_ELBOW = 90;
     static const int HOME_GRIPPER = 90;
     static const int MAX_COMMANDS = 20;
+    static const int MAX_JOB_STEPS = 20;
+    static const unsigned long MOVE_INTERVAL = 10;  // 1 degree per 10ms tick
+    static const unsigned long JOG_TIMEOUT = 5000;  // stop if no release arrives
+    static const int MAX_JOG_SPEED = 180;           // degrees per second
+    static const int EASE_DEGREES = 3;              // run-out of an eased abort
+
+    // Current job
+    ArmStep job[MAX_JOB_STEPS];
+    uint8_t jobLength;
+    uint8_t jobIndex;
+    JobState jobState;
+    unsigned int waitTicks;  // ticks left in the current wait step
+    unsigned long lastTickTime;
+
+    // Current jog
+    bool jogActive;
+    uint8_t jogJoint;
+    int jogVelocity;           // degrees per second, signed
+    long jogAccumulator;       // millidegrees not yet applied
+    unsigned long jogStartTime;
 
     // Saved positions
     struct Position {
@@ -86,11 +130,17 @@ class RobotArm {
     int commandCount;
     bool recording;
 
+    bool (*waitHook)();
+
     // Helper functions
-    void moveServo(Servo &servo, char direction, int *currentAngle);
-    void moveToAngle(Servo &servo, int *currentAngle, int targetAngle);
+    void startJob(const ArmStep *steps, uint8_t count);
+    void startMove(uint8_t joint, int targetAngle);
+    void updateJog(unsigned long now, unsigned long elapsed);
+    bool waitFor(unsigned long ms);
     void loadPositionsFromEEPROM();
     void savePositionsToEEPROM();
 };
 
+typedef RobotArm<Board::Pins> BoardArm;
+
 #endif
@@ -0,0 +1,138 @@
+#include "SensorArray.h"
+
+template <class Pins>
+SensorArray<Pins>::SensorArray() {
+    count = 0;
+    groupCount = 0;
+    activeGroup = 0;
+    inFlight = false;
+    firedAt = 0;
+    roundStart = 0;
+    interval = 100;  // 10 readings per second per sensor
+    idle = false;
+    lead = NULL;
+    memset(&building, 0, sizeof(building));
+}
+
+// Groups are numbered from 0; an empty group still takes a slot
+template <class Pins>
+int8_t SensorArray<Pins>::addSensor(uint8_t trigPin, uint8_t echoPin, float angle, uint8_t group) {
+    if (count >= MAX_SENSORS) return -1;
+    Sensor &s = sensors[count];
+    s.trigPin = trigPin;
+    s.echoPin = echoPin;
+    s.group = group;
+    s.armed = s.rising = s.done = false;
+    s.riseAt = s.width = 0;
+    s.lastReading = 0;
+    building.distance[count] = UltrasonicSensor<Pins>::MAX_DISTANCE;
+    building.angle[count] = angle;
+    building.rate[count] = 0;
+    building.count = count + 1;
+    groupCount = max(groupCount, (uint8_t)(group + 1));
+    return count++;
+}
+
+template <class Pins>
+void SensorArray<Pins>::begin() {
+    for (uint8_t i = 0; i < count; i++) {
+        pinMode(sensors[i].trigPin, OUTPUT);
+        digitalWrite(sensors[i].trigPin, LOW);
+        pinMode(sensors[i].echoPin, INPUT);
+        attachInterruptArg(digitalPinToInterrupt(sensors[i].echoPin), onEcho, &sensors[i], CHANGE);
+    }
+}
+
+template <class Pins>
+void IRAM_ATTR SensorArray<Pins>::onEcho(void *arg) {
+    Sensor *s = static_cast<Sensor *>(arg);
+    if (!s->armed) return;
+    uint32_t now = micros();
+    if (digitalRead(s->echoPin)) {
+        s->riseAt = now;
+        s->rising = true;
+    } else if (s->rising) {
+        s->width = now - s->riseAt;
+        s->done = true;
+        s->armed = false;
+    }
+}
+
+// Non-blocking, call from the control loop. Collects the group in flight
+// once every echo is back, then triggers the next group when its slot
+// comes round.
+template <class Pins>
+void SensorArray<Pins>::update() {
+    if (count == 0) return;
+    uint32_t now = micros();
+
+    if (inFlight) {
+        bool complete = now - firedAt >= STUCK_TIME;
+        for (uint8_t i = 0; i < count && !complete; i++) {
+            if (sensors[i].group == activeGroup && !sensors[i].done) break;
+            if (i == count - 1) complete = true;
+        }
+        if (!complete) return;
+
+        collect(activeGroup);
+        inFlight = false;
+        if (++activeGroup >= groupCount) {
+            activeGroup = 0;
+            building.round++;
+            building.time = millis();
+            published.write(building);
+        }
+    }
+
+    if (idle || now - firedAt < SLOT_TIME) return;
+    if (activeGroup == 0 && millis() - roundStart < interval) return;
+    if (lead && lead->nextReadIn() < LEAD_QUIET) return;
+
+    if (activeGroup == 0) roundStart = millis();
+    trigger(activeGroup);
+}
+
+template <class Pins>
+void SensorArray<Pins>::trigger(uint8_t group) {
+    for (uint8_t i = 0; i < count; i++) {
+        Sensor &s = sensors[i];
+        if (s.group != group) continue;
+        s.rising = s.done = false;
+        s.armed = true;
+    }
+    // Sensors may share a trigger line; pulse each line once
+    for (uint8_t i = 0; i < count; i++) {
+        if (sensors[i].group != group) continue;
+        bool pulsed = false;
+        for (uint8_t j = 0; j < i && !pulsed; j++) {
+            pulsed = sensors[j].group == group && sensors[j].trigPin == sensors[i].trigPin;
+        }
+        if (pulsed) continue;
+        digitalWrite(sensors[i].trigPin, HIGH);
+        delayMicroseconds(10);
+        digitalWrite(sensors[i].trigPin, LOW);
+    }
+    firedAt = micros();
+    inFlight = true;
+}
+
+// A pulse past ECHO_TIMEOUT, or none at all, reads as MAX_DISTANCE
+template <class Pins>
+void SensorArray<Pins>::collect(uint8_t group) {
+    unsigned long now = millis();
+    for (uint8_t i = 0; i < count; i++) {
+        Sensor &s = sensors[i];
+        if (s.group != group) continue;
+        s.armed = false;
+        bool echo = s.done && s.width < ECHO_TIMEOUT;
+        building.distance[i] = echo ? s.width * 0.034f / 2 : UltrasonicSensor<Pins>::MAX_DISTANCE;
+        if (s.lastReading != 0 && now > s.lastReading) {
+            float rate = 1000.0f / (now - s.lastReading);
+            building.rate[i] += RATE_SMOOTHING * (rate - building.rate[i]);
+        }
+        s.lastReading = now;
+    }
+}
+
+// Instantiated for the board selected in BoardConfig.h
+template class SensorArray<Board::Pins>;
@@ -0,0 +1,86 @@
+#ifndef SENSOR_ARRAY_H
+#define SENSOR_ARRAY_H
+
+#include <Arduino.h>
+#include "BoardConfig.h"
+#include "Seqlock.h"
+#include "UltrasonicSensor.h"
+
+// Extra HC-SR04s around the robot, read without blocking. Sensors in one
+// group trigger together and pin interrupts time their echoes; groups take
+// turns, so sensors that could hear each other's ping belong in different
+// groups. Each completed round is published as one snapshot.
+template <class Pins>
+class SensorArray {
+  public:
+    static const uint8_t MAX_SENSORS = 6;
+
+    // One reading per sensor, all from the same round
+    struct Snapshot {
+      uint8_t count;
+      uint32_t round;                 // rounds completed so far
+      float distance[MAX_SENSORS];    // cm, MAX_DISTANCE when no echo
+      float angle[MAX_SENSORS];       // degrees from straight ahead, left positive
+      float rate[MAX_SENSORS];        // readings per second, measured
+      unsigned long time;             // millis() when the round completed
+    };
+
+  private:
+    // The echo fields are written by the interrupt while armed
+    struct Sensor {
+      uint8_t trigPin;
+      uint8_t echoPin;
+      uint8_t group;
+      volatile bool armed;
+      volatile bool rising;
+      volatile bool done;
+      volatile uint32_t riseAt;       // micros() of the echo's rising edge
+      volatile uint32_t width;        // echo pulse, us
+      unsigned long lastReading;      // millis(), 0 = none yet
+    };
+
+    Sensor sensors[MAX_SENSORS];
+    uint8_t count;
+    uint8_t groupCount;
+    uint8_t activeGroup;
+    bool inFlight;
+    uint32_t firedAt;                 // micros() of the last trigger
+    unsigned long roundStart;
+    unsigned long interval;           // ms between readings of one sensor, at least
+    bool idle;                        // no new rounds start
+    Snapshot building;
+    Seqlock<Snapshot> published;
+    UltrasonicSensor<Pins> *lead;
+    const uint32_t ECHO_TIMEOUT = 25000;  // us, about 4m round trip, as UltrasonicSensor
+    const uint32_t SLOT_TIME = 30000;     // us from one group's trigger to the next
+    const uint32_t STUCK_TIME = 40000;    // us; with no return an HC-SR04 holds echo ~38ms
+    // ms the lead sensor must stay idle after a trigger: our echoes can take
+    // the full STUCK_TIME, so the gate covers it, rounded up
+    const unsigned long LEAD_QUIET = (STUCK_TIME + 999) / 1000;
+    const float RATE_SMOOTHING = 0.2;
+
+    static void IRAM_ATTR onEcho(void *arg);
+    void trigger(uint8_t group);
+    void collect(uint8_t group);
+
+  public:
+    SensorArray();
+    // Returns the sensor's index in the snapshot, or -1 when the array is full
+    int8_t addSensor(uint8_t trigPin, uint8_t echoPin, float angle, uint8_t group);
+    void begin();
+    void update();
+    // Triggers only while the lead (blocking) sensor has LEAD_QUIET to go,
+    // so its reading never overlaps one of ours
+    void setLead(UltrasonicSensor<Pins> *sensor) { lead = sensor; }
+    void setInterval(unsigned long ms) { interval = ms; }
+    unsigned long getInterval() { return interval; }
+    // Idle lets the group in flight finish, then stops triggering
+    void setIdle(bool on) { idle = on; }
+    bool isIdle() { return idle; }
+    uint8_t size() { return count; }
+    Snapshot getSnapshot() const { return published.read(); }  // either side
+};
+
+typedef SensorArray<Board::Pins> BoardSensorArray;
+
+#endif
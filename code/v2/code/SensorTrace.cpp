@@ -0,0 +1,35 @@
+#include "SensorTrace.h"
+
+SensorTrace::SensorTrace() : count(0), recording(false) {
+    memset(&header, 0, sizeof(header));
+    lastTime = 0;
+}
+
+void SensorTrace::start(const TraceHeader &settings, unsigned long now) {
+    recording.store(false, std::memory_order_release);
+    count.store(0, std::memory_order_release);
+    header = settings;
+    memcpy(header.magic, "OATR", 4);
+    header.version = TRACE_VERSION;
+    header.startTime = now;
+    lastTime = now;
+    recording.store(true, std::memory_order_release);
+}
+
+void SensorTrace::stop() {
+    recording.store(false, std::memory_order_release);
+}
+
+// Returns false once the trace is not (or no longer) recording
+bool SensorTrace::record(unsigned long time, uint16_t echo, int left, int right) {
+    if (!recording.load(std::memory_order_relaxed)) return false;
+    uint16_t n = count.load(std::memory_order_relaxed);
+    if (n >= CAPACITY) {
+        stop();
+        return false;
+    }
+    entries[n] = {(uint16_t)min(time - lastTime, 65535UL), echo, (int16_t)left, (int16_t)right};
+    lastTime = time;
+    count.store(n + 1, std::memory_order_release);
+    return true;
+}
@@ -0,0 +1,65 @@
+#ifndef SENSOR_TRACE_H
+#define SENSOR_TRACE_H
+
+#include <Arduino.h>
+#include <atomic>
+
+// Trace format, little-endian: one TraceHeader, then one TraceEntry per
+// published distance sample. The host replay tool in code/v2/sim reads the
+// same structs, so keep them in step with it.
+struct TraceHeader {
+    char magic[4];        // "OATR"
+    uint8_t version;
+    uint8_t navMode;      // ObstacleAvoidance::NavMode when recording began
+    uint8_t flags;        // TRACE_OA_ACTIVE, TRACE_NAVIGATING
+    int8_t wallAngle;     // wall-following sensor angle, degrees
+    int16_t speed;        // motor speed setting
+    int16_t maxDuty;      // BoardMotors::MAX_DUTY of the recording board
+    uint32_t startTime;   // millis() when recording began
+    uint16_t rotationRate; // OA spin rate at full duty, 0.1 deg/s
+    uint8_t wallTarget;   // wall-following distance, cm
+    uint8_t wallSpeed;    // wall-following speed, % of the speed setting
+};
+
+struct TraceEntry {
+    uint16_t dt;          // ms since the previous entry (the first: since startTime)
+    uint16_t echo;        // raw echo pulse, us, 0 = none
+    int16_t left;         // signed wheel duty when the sample was published
+    int16_t right;
+};
+
+static_assert(sizeof(TraceHeader) == 20 && sizeof(TraceEntry) == 8, "Trace structs must stay packed");
+
+const uint8_t TRACE_VERSION = 1;
+const uint8_t TRACE_OA_ACTIVE = 0x01;
+const uint8_t TRACE_NAVIGATING = 0x02;
+
+// Records raw ultrasonic echoes and the wheel duties beside them in RAM.
+// The control loop records; the network side may read the entries already
+// counted while recording goes on, since recorded entries never change.
+// Recording stops when the buffer is full rather than wrapping, so a trace
+// always replays from the state it began in.
+class SensorTrace {
+  public:
+    static const uint16_t CAPACITY = 1024;  // 8KB, about 50s at 20 samples/s
+
+    SensorTrace();
+    // settings: everything but magic, version and startTime
+    void start(const TraceHeader &settings, unsigned long now);
+    void stop();
+    bool record(unsigned long time, uint16_t echo, int left, int right);
+
+    bool isRecording() const { return recording.load(std::memory_order_acquire); }
+    uint16_t size() const { return count.load(std::memory_order_acquire); }
+    const TraceHeader &getHeader() const { return header; }
+    const TraceEntry *getEntries() const { return entries; }
+
+  private:
+    TraceHeader header;
+    TraceEntry entries[CAPACITY];
+    std::atomic<uint16_t> count;
+    std::atomic<bool> recording;
+    unsigned long lastTime;
+};
+
+#endif
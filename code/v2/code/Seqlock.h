@@ -0,0 +1,39 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <Arduino.h>
+#include <atomic>
+
+// Single-writer snapshot. The writer never waits; readers retry if a write
+// landed while they were copying. T must be trivially copyable.
+template <class T>
+class Seqlock {
+  private:
+    std::atomic<uint32_t> sequence;
+    T value;
+
+  public:
+    Seqlock() : sequence(0), value() {}
+
+    void write(const T &next) {
+        uint32_t seq = sequence.load(std::memory_order_relaxed);
+        sequence.store(seq + 1, std::memory_order_relaxed);  // odd = write in progress
+        std::atomic_thread_fence(std::memory_order_release);
+        value = next;
+        sequence.store(seq + 2, std::memory_order_release);
+    }
+
+    T read() const {
+        T copy;
+        uint32_t before, after;
+        do {
+            before = sequence.load(std::memory_order_acquire);
+            copy = value;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = sequence.load(std::memory_order_relaxed);
+        } while ((before & 1) || before != after);
+        return copy;
+    }
+};
+
+#endif
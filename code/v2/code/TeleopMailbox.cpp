@@ -0,0 +1,68 @@
+#include "TeleopMailbox.h"
+
+TeleopMailbox::TeleopMailbox()
+    : sequence(0), lastTaken(0), synced(false), bestOffset(0), lastClientTime(0), maxAge(250),
+      stale(0), lastAgeMs(0), taken(0), overwritten(0), expired(0) {
+}
+
+// Producer side
+void TeleopMailbox::reset() {
+    synced = false;
+}
+
+bool TeleopMailbox::post(TeleopInput input) {
+    uint32_t now = millis();
+    int32_t offset = (int32_t)(now - input.clientTime);
+
+    if (synced && (int32_t)(input.clientTime - lastClientTime) <= 0) {
+        stale.fetch_add(1, std::memory_order_relaxed);  // duplicate or reordered
+        return false;
+    }
+    if (!synced || offset < bestOffset) {
+        synced = true;
+        bestOffset = offset;
+    }
+
+    uint32_t age = (uint32_t)(offset - bestOffset);
+    lastAgeMs.store(age, std::memory_order_relaxed);
+    if (age > maxAge) {
+        stale.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    lastClientTime = input.clientTime;
+    input.receivedAt = now;
+    input.sequence = sequence.load(std::memory_order_relaxed) + 1;
+    slot.write(input);
+    sequence.store(input.sequence, std::memory_order_release);
+    return true;
+}
+
+// Consumer side
+bool TeleopMailbox::take(TeleopInput &input) {
+    if (sequence.load(std::memory_order_acquire) == lastTaken) return false;
+
+    input = slot.read();
+    if (input.sequence == lastTaken) return false;
+    overwritten.fetch_add(input.sequence - lastTaken - 1, std::memory_order_relaxed);
+    lastTaken = input.sequence;
+
+    // Sat in the slot while the control loop was busy
+    if (millis() - input.receivedAt > maxAge) {
+        expired.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    taken.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+TeleopMailbox::Stats TeleopMailbox::getStats() const {
+    Stats stats;
+    stats.posted = sequence.load(std::memory_order_relaxed);
+    stats.taken = taken.load(std::memory_order_relaxed);
+    stats.stale = stale.load(std::memory_order_relaxed);
+    stats.overwritten = overwritten.load(std::memory_order_relaxed);
+    stats.expired = expired.load(std::memory_order_relaxed);
+    stats.lastAgeMs = lastAgeMs.load(std::memory_order_relaxed);
+    return stats;
+}
@@ -0,0 +1,71 @@
+#ifndef TELEOP_MAILBOX_H
+#define TELEOP_MAILBOX_H
+
+#include <Arduino.h>
+#include <atomic>
+#include "Seqlock.h"
+
+// One frame of the teleop stream: drive and arm axes, each -100..100
+struct TeleopInput {
+    static const uint8_t ARM_AXES = 4;  // base, shoulder, elbow, gripper
+    int8_t linear;
+    int8_t angular;
+    int8_t arm[ARM_AXES];
+    uint32_t clientTime;   // sender clock, ms
+    uint32_t receivedAt;   // millis() when accepted
+    uint32_t sequence;     // assigned by the mailbox
+};
+
+// Single-slot, latest-wins mailbox between the network side (single
+// producer) and the control loop (single consumer). A new frame overwrites
+// the one before it, so the control loop only ever acts on the newest input.
+//
+// Frames carry the sender's clock. The device cannot compare clocks
+// directly, so it tracks the smallest (local - sender) offset seen since the
+// client connected; a frame whose offset exceeds that by more than maxAge
+// spent too long in flight and is rejected. Frames older than the last
+// accepted one (reordered) are rejected too.
+class TeleopMailbox {
+  public:
+    struct Stats {
+      uint32_t posted;
+      uint32_t taken;
+      uint32_t stale;        // rejected on arrival: too old or out of order
+      uint32_t overwritten;  // accepted but replaced before the control loop ran
+      uint32_t expired;      // went stale waiting for the control loop
+      uint32_t lastAgeMs;    // in-flight delay above the best seen
+    };
+
+    TeleopMailbox();
+
+    // Producer side
+    void reset();  // new client: forget its clock
+    bool post(TeleopInput input);
+
+    // Consumer side: true if a frame newer than the last take() is waiting
+    // and it is still fresh
+    bool take(TeleopInput &input);
+
+    void setMaxAge(uint32_t ms) { maxAge = ms; }
+    Stats getStats() const;
+
+  private:
+    Seqlock<TeleopInput> slot;
+    std::atomic<uint32_t> sequence;
+    uint32_t lastTaken;  // consumer-owned
+
+    // Producer-owned clock tracking
+    bool synced;
+    int32_t bestOffset;
+    uint32_t lastClientTime;
+    uint32_t maxAge;
+
+    // Each counter has a single writer: producer or consumer
+    std::atomic<uint32_t> stale;
+    std::atomic<uint32_t> lastAgeMs;
+    std::atomic<uint32_t> taken;
+    std::atomic<uint32_t> overwritten;
+    std::atomic<uint32_t> expired;
+};
+
+#endif
@@ -1,38 +1,129 @@
 #include "UltrasonicSensor.h"
 
-UltrasonicSensor::UltrasonicSensor(uint8_t trig, uint8_t echo) {
-    trigPin = trig;
-    echoPin = echo;
+template <class Pins>
+UltrasonicSensor<Pins>::UltrasonicSensor() {
     lastReadTime = 0;
     lastDistance = 0;
+    lastEcho = 0;
+    windowCount = 0;
+    lastSample = {MAX_DISTANCE, MAX_DISTANCE, 0, 0};
+    subscriberCount = 0;
+    readInterval = 50;
+    sampleRate = 0;
 }
 
-void UltrasonicSensor::begin() {
-    pinMode(trigPin, OUTPUT);
-    pinMode(echoPin, INPUT);
+template <class Pins>
+void UltrasonicSensor<Pins>::begin() {
+    pinMode(Pins::TRIG_PIN, OUTPUT);
+    pinMode(Pins::ECHO_PIN, INPUT);
 }
 
-float UltrasonicSensor::getDistance() {
+// Takes one reading per readInterval and hands it to every subscriber, so
+// they all share it instead of each triggering their own
+template <class Pins>
+void UltrasonicSensor<Pins>::update() {
+    if (millis() - lastReadTime < readInterval) return;
+
+    float raw = getDistance();
+    if (windowCount < 3) {
+        window[windowCount++] = raw;
+    } else {
+        window[0] = window[1];
+        window[1] = window[2];
+        window[2] = raw;
+    }
+
+    // Median of three drops single-echo spikes without the 10ms waits of
+    // getFilteredDistance()
+    float distance = raw;
+    if (windowCount == 3) {
+        float a = window[0], b = window[1], c = window[2];
+        distance = max(min(a, b), min(max(a, b), c));
+    }
+    if (lastSample.time != 0 && lastReadTime > lastSample.time) {
+        float rate = 1000.0f / (lastReadTime - lastSample.time);
+        sampleRate += RATE_SMOOTHING * (rate - sampleRate);
+    }
+    lastSample = {distance, raw, lastReadTime, lastEcho};
+    publish(lastSample);
+}
+
+template <class Pins>
+void UltrasonicSensor<Pins>::publish(const DistanceSample &sample) {
+    for (uint8_t i = 0; i < subscriberCount; i++) {
+        Subscriber &s = subscribers[i];
+        if (s.threshold <= 0) {
+            s.listener(s.context, i, DISTANCE_SAMPLE, sample);
+        } else {
+            evaluate(i, sample);
+        }
+    }
+}
+
+// Tells a threshold subscriber when the sample puts it on the other side
+template <class Pins>
+void UltrasonicSensor<Pins>::evaluate(uint8_t id, const DistanceSample &sample) {
+    Subscriber &s = subscribers[id];
+    if (!s.near && sample.distance <= s.threshold) {
+        s.near = true;
+        s.listener(s.context, id, DISTANCE_NEAR, sample);
+    } else if (s.near && sample.distance > s.threshold + s.hysteresis) {
+        s.near = false;
+        s.listener(s.context, id, DISTANCE_CLEAR, sample);
+    }
+}
+
+template <class Pins>
+int8_t UltrasonicSensor<Pins>::subscribe(DistanceListener listener, void *context, float threshold, float hysteresis) {
+    if (subscriberCount >= MAX_SUBSCRIBERS || listener == NULL) return -1;
+    subscribers[subscriberCount] = {listener, context, threshold, hysteresis, false};
+    return subscriberCount++;
+}
+
+// The last sample is checked against the moved threshold right away, so a
+// threshold moved across the current distance fires without waiting for
+// the next reading. Turning the threshold off clears the state quietly.
+template <class Pins>
+void UltrasonicSensor<Pins>::setThreshold(int8_t id, float threshold, float hysteresis) {
+    if (id < 0 || id >= subscriberCount) return;
+    Subscriber &s = subscribers[id];
+    s.threshold = threshold;
+    s.hysteresis = hysteresis;
+    if (threshold <= 0) {
+        s.near = false;
+    } else if (lastSample.time != 0) {
+        evaluate(id, lastSample);
+    }
+}
+
+template <class Pins>
+float UltrasonicSensor<Pins>::getDistance() {
     unsigned long currentTime = millis();
-    if (currentTime - lastReadTime >= READ_INTERVAL) {
-        digitalWrite(trigPin, LOW);
+    if (currentTime - lastReadTime >= readInterval) {
+        digitalWrite(Pins::TRIG_PIN, LOW);
         delayMicroseconds(2);
-        digitalWrite(trigPin, HIGH);
+        digitalWrite(Pins::TRIG_PIN, HIGH);
         delayMicroseconds(10);
-        digitalWrite(trigPin, LOW);
+        digitalWrite(Pins::TRIG_PIN, LOW);
         
-        long duration = pulseIn(echoPin, HIGH);
-        lastDistance = duration * 0.034 / 2;
+        // No echo within range reads as far away, not as 0cm
+        long duration = pulseIn(Pins::ECHO_PIN, HIGH, ECHO_TIMEOUT);
+        lastEcho = duration;
+        lastDistance = duration > 0 ? duration * 0.034 / 2 : MAX_DISTANCE;
         lastReadTime = currentTime;
     }
     return lastDistance;
 }
 
-float UltrasonicSensor::getFilteredDistance(int samples) {
+template <class Pins>
+float UltrasonicSensor<Pins>::getFilteredDistance(int samples) {
     float sum = 0;
     for (int i = 0; i < samples; i++) {
         sum += getDistance();
         delay(10);
     }
     return sum / samples;
-}
\ No newline at end of file
+}
+
+// Instantiated for the board selected in BoardConfig.h
+template class UltrasonicSensor<Board::Pins>;
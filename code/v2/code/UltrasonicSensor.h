@@ -2,19 +2,82 @@
 #define ULTRASONIC_SENSOR_H
 
 #include <Arduino.h>
+#include "BoardConfig.h"
 
+// One published reading
+struct DistanceSample {
+    float distance;      // median of the last three readings, cm
+    float raw;           // this reading alone, cm
+    unsigned long time;  // millis() when it was taken
+    uint16_t echo;       // raw echo pulse of this reading, us, 0 = none
+};
+
+enum DistanceEvent : uint8_t {
+    DISTANCE_SAMPLE,  // every new sample (subscribers without a threshold)
+    DISTANCE_NEAR,    // fell to or below the threshold
+    DISTANCE_CLEAR    // rose above threshold + hysteresis
+};
+
+// id is the one subscribe() returned, so one listener can watch several thresholds
+typedef void (*DistanceListener)(void *context, int8_t id, DistanceEvent event, const DistanceSample &sample);
+
+template <class Pins>
 class UltrasonicSensor {
+  public:
+    static const uint8_t MAX_SUBSCRIBERS = 8;
+    static constexpr float MAX_DISTANCE = 400.0f;  // reported when no echo returns
+    static constexpr unsigned long MIN_READ_INTERVAL = 30;  // ms, past the echo timeout
+
   private:
-    uint8_t trigPin, echoPin;
+    // A threshold of 0 means the subscriber gets every sample
+    struct Subscriber {
+      DistanceListener listener;
+      void *context;
+      float threshold;
+      float hysteresis;
+      bool near;
+    };
+
     unsigned long lastReadTime;
     float lastDistance;
-    const unsigned long READ_INTERVAL = 50; // 50ms between readings
-    
+    uint16_t lastEcho;
+    float window[3];
+    uint8_t windowCount;
+    DistanceSample lastSample;
+    Subscriber subscribers[MAX_SUBSCRIBERS];
+    uint8_t subscriberCount;
+    unsigned long readInterval;   // ms between readings
+    float sampleRate;             // published samples per second, measured
+    const unsigned long ECHO_TIMEOUT = 25000; // us, about 4m round trip
+    const float RATE_SMOOTHING = 0.2;
+
+    void publish(const DistanceSample &sample);
+    void evaluate(uint8_t id, const DistanceSample &sample);
+
   public:
-    UltrasonicSensor(uint8_t trig, uint8_t echo);
+    UltrasonicSensor();
     void begin();
+    void update();
     float getDistance();
     float getFilteredDistance(int samples = 3);
+    float getLastDistance() { return lastDistance; }
+    // ms until update() takes its next reading, 0 = due now
+    unsigned long nextReadIn() {
+        unsigned long elapsed = millis() - lastReadTime;
+        return elapsed >= readInterval ? 0 : readInterval - elapsed;
+    }
+    void setReadInterval(unsigned long ms) { readInterval = max(ms, MIN_READ_INTERVAL); }
+    unsigned long getReadInterval() { return readInterval; }
+    float getSampleRate() { return sampleRate; }
+    const DistanceSample &getLastSample() { return lastSample; }
+
+    // Subscribers are called from update() and setThreshold(), on the
+    // control loop. Returns an id for setThreshold(), or -1 when the list
+    // is full.
+    int8_t subscribe(DistanceListener listener, void *context, float threshold = 0, float hysteresis = 0);
+    void setThreshold(int8_t id, float threshold, float hysteresis);
 };
 
-#endif
\ No newline at end of file
+typedef UltrasonicSensor<Board::Pins> BoardSensor;
+
+#endif
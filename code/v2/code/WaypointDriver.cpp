@@ -0,0 +1,67 @@
+#include "WaypointDriver.h"
+
+WaypointDriver::WaypointDriver(BoardMotors* m, Odometry* o) {
+    motors = m;
+    odometry = o;
+    count = 0;
+    current = 0;
+    state = ROUTE_IDLE;
+    lastUpdate = 0;
+    tolerance = 5.0;  // cm
+}
+
+void WaypointDriver::clear() {
+    cancel();
+    count = 0;
+}
+
+bool WaypointDriver::add(float x, float y) {
+    if (count >= MAX_WAYPOINTS) return false;
+    routeX[count] = x;
+    routeY[count] = y;
+    count++;
+    return true;
+}
+
+void WaypointDriver::start() {
+    current = 0;
+    state = count > 0 ? ROUTE_DRIVING : ROUTE_IDLE;
+}
+
+void WaypointDriver::cancel() {
+    if (state != ROUTE_DRIVING) return;
+    state = ROUTE_IDLE;
+    motors->stop();
+}
+
+// Non-blocking, call from the control loop
+void WaypointDriver::update() {
+    if (state != ROUTE_DRIVING) return;
+    unsigned long now = millis();
+    if (now - lastUpdate < UPDATE_INTERVAL) return;
+    lastUpdate = now;
+
+    Odometry::Pose pose = odometry->getPose();
+    float dx = routeX[current] - Odometry::toCm(pose.x);
+    float dy = routeY[current] - Odometry::toCm(pose.y);
+    float distance = sqrtf(dx * dx + dy * dy);
+    if (distance <= tolerance) {
+        if (++current >= count) {
+            state = ROUTE_ARRIVED;
+            motors->stop();
+        }
+        return;
+    }
+
+    // Bearing error as a binary angle, so the wrap to -180..180 is free
+    uint32_t bearing = Odometry::fromDegrees(atan2f(dy, dx) * RAD_TO_DEG);
+    float error = Odometry::toDegrees(bearing - pose.theta);
+    float steer = constrain(error * DEG_TO_RAD * STEER_GAIN, -1.0f, 1.0f);
+    if (fabsf(error) > TURN_IN_PLACE) {
+        float rotate = max(fabsf(steer), MIN_ROTATE);
+        motors->setVelocity(0, error > 0 ? rotate : -rotate);
+        return;
+    }
+    float linear = MIN_LINEAR + (1.0f - MIN_LINEAR) * min(distance / SLOW_RADIUS, 1.0f);
+    motors->setVelocity(linear, steer);
+}
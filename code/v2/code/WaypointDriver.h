@@ -0,0 +1,51 @@
+#ifndef WAYPOINT_DRIVER_H
+#define WAYPOINT_DRIVER_H
+
+#include "MotorController.h"
+#include "Odometry.h"
+
+// Drives through a short route on the odometry pose. A waypoint well off
+// the nose is turned to in place; otherwise the robot drives with a
+// proportional steer, slowing inside SLOW_RADIUS. With OA enabled the
+// speed governor still scales the forward speed.
+class WaypointDriver {
+  public:
+    static const uint8_t MAX_WAYPOINTS = 8;
+
+    enum State : uint8_t {
+      ROUTE_IDLE,
+      ROUTE_DRIVING,
+      ROUTE_ARRIVED
+    };
+
+  private:
+    BoardMotors* motors;
+    Odometry* odometry;
+    float routeX[MAX_WAYPOINTS];  // cm
+    float routeY[MAX_WAYPOINTS];
+    uint8_t count;
+    uint8_t current;
+    State state;
+    unsigned long lastUpdate;
+    float tolerance;                          // cm from a waypoint that counts as reached
+    const unsigned long UPDATE_INTERVAL = 20; // ms
+    const float TURN_IN_PLACE = 35.0;         // degrees of bearing error
+    const float STEER_GAIN = 1.2;             // angular command per radian of error
+    const float SLOW_RADIUS = 25.0;           // cm; the forward command fades inside this
+    const float MIN_LINEAR = 0.35;            // forward command at the waypoint
+    const float MIN_ROTATE = 0.4;             // turn-in-place command at small errors
+
+  public:
+    WaypointDriver(BoardMotors* m, Odometry* o);
+    void clear();
+    bool add(float x, float y);  // cm in the odometry frame; false when full
+    void start();
+    void cancel();
+    void update();
+    void setTolerance(float cm) { if (cm > 0) tolerance = cm; }
+    State getState() { return state; }
+    bool driving() { return state == ROUTE_DRIVING; }
+    uint8_t remaining() { return state == ROUTE_DRIVING ? count - current : 0; }
+};
+
+#endif
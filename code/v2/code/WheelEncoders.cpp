@@ -0,0 +1,53 @@
+#include "WheelEncoders.h"
+
+template <class Pins>
+WheelEncoders<Pins>::WheelEncoders() {
+    present = false;
+    for (uint8_t i = 0; i < 2; i++) {
+        channels[i].pin = Board::NO_PIN;
+        channels[i].direction = 1;
+        channels[i].ticks = 0;
+        channels[i].lastTick = 0;
+    }
+}
+
+template <class Pins>
+void WheelEncoders<Pins>::begin(uint8_t leftPin, uint8_t rightPin) {
+    if (leftPin == Board::NO_PIN || rightPin == Board::NO_PIN) return;
+    channels[0].pin = leftPin;
+    channels[1].pin = rightPin;
+    for (uint8_t i = 0; i < 2; i++) {
+        pinMode(channels[i].pin, INPUT);
+        attachInterruptArg(digitalPinToInterrupt(channels[i].pin), onTick, &channels[i], RISING);
+    }
+    present = true;
+}
+
+template <class Pins>
+void IRAM_ATTR WheelEncoders<Pins>::onTick(void *arg) {
+    Channel *channel = static_cast<Channel *>(arg);
+    channel->ticks = channel->ticks + channel->direction;
+    channel->lastTick = micros();
+}
+
+// Reread if a tick landed between the two reads
+template <class Pins>
+int32_t WheelEncoders<Pins>::getTicks(uint8_t wheel, uint32_t &at) {
+    const Channel &channel = channels[wheel];
+    int32_t ticks;
+    do {
+        ticks = channel.ticks;
+        at = channel.lastTick;
+    } while (ticks != channel.ticks);
+    return ticks;
+}
+
+// A stopped wheel keeps its last direction, so ticks while it coasts to a
+// halt still count the right way
+template <class Pins>
+void WheelEncoders<Pins>::setDirection(uint8_t wheel, int duty) {
+    if (duty != 0) channels[wheel].direction = duty > 0 ? 1 : -1;
+}
+
+// Instantiated for the board selected in BoardConfig.h
+template class WheelEncoders<Board::Pins>;
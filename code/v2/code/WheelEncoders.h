@@ -0,0 +1,40 @@
+#ifndef WHEEL_ENCODERS_H
+#define WHEEL_ENCODERS_H
+
+#include <Arduino.h>
+#include "BoardConfig.h"
+
+// Single-channel wheel encoders, one tick per slot, counted in a pin
+// interrupt. One channel cannot tell direction, so each tick takes the
+// sign of the wheel's last non-zero duty, which the control loop passes
+// in with setDirection().
+template <class Pins>
+class WheelEncoders {
+  private:
+    struct Channel {
+      uint8_t pin;
+      volatile int8_t direction;
+      volatile int32_t ticks;
+      volatile uint32_t lastTick;     // micros() of the latest tick
+    };
+
+    Channel channels[2];
+    bool present;
+
+    static void IRAM_ATTR onTick(void *arg);
+
+  public:
+    WheelEncoders();
+    // NO_PIN on either side leaves the encoders absent
+    void begin(uint8_t leftPin, uint8_t rightPin);
+    bool isPresent() { return present; }
+    void setDirection(uint8_t wheel, int duty);
+    // Signed ticks since begin(); one aligned word, so either side may read it
+    int32_t getTicks(uint8_t wheel) { return channels[wheel].ticks; }
+    // Ticks together with the micros() of the latest one, for speed
+    int32_t getTicks(uint8_t wheel, uint32_t &at);
+};
+
+typedef WheelEncoders<Board::Pins> BoardEncoders;
+
+#endif
@@ -0,0 +1,101 @@
+#include "WheelSpeedControl.h"
+
+// Trims are limited to half of full duty either way
+WheelSpeedControl::WheelSpeedControl(BoardMotors* m, BoardEncoders* e, Odometry* o)
+    : wheels{{PidController(1.0, 12.0, 0, 0.5), 0, 0, false, 0, 0, false},
+             {PidController(1.0, 12.0, 0, 0.5), 0, 0, false, 0, 0, false}} {
+    motors = m;
+    encoders = e;
+    odometry = o;
+    enabled = false;
+    lastUpdate = 0;
+}
+
+void WheelSpeedControl::begin() {
+    enable(encoders->isPresent());
+}
+
+void WheelSpeedControl::enable(bool on) {
+    enabled = on && encoders->isPresent();
+    release();
+}
+
+void WheelSpeedControl::setGains(float p, float i, float d) {
+    for (uint8_t w = 0; w < 2; w++) {
+        wheels[w].pid.setGains(p, i, d);
+        wheels[w].pid.reset();
+    }
+}
+
+// Back to open loop, with fresh tick references for the next start
+void WheelSpeedControl::release() {
+    for (uint8_t w = 0; w < 2; w++) {
+        Wheel &wheel = wheels[w];
+        wheel.pid.reset();
+        wheel.lastTicks = encoders->getTicks(w, wheel.lastTickAt);
+        wheel.setpoint = wheel.speed = 0;
+        wheel.ticked = wheel.measured = false;
+        motors->setTrim(w, 0);
+    }
+    lastUpdate = millis();
+}
+
+void WheelSpeedControl::update() {
+    unsigned long now = millis();
+    unsigned long elapsed = now - lastUpdate;
+    if (!enabled || elapsed < INTERVAL) return;
+    lastUpdate = now;
+
+    float fullSpeed = max(odometry->getCalibration().maxSpeed, (int32_t)1);  // mm/s
+    for (uint8_t w = 0; w < 2; w++) {
+        Wheel &wheel = wheels[w];
+        wheel.setpoint = odometry->getModelSpeed(w);
+        wheel.speed = measure(wheel, w);
+        int duty = motors->getDuty(w);
+        if (duty == 0) {
+            // Stopped or coasting through a reversal: nothing to hold
+            wheel.measured = false;
+        }
+        if (!wheel.measured) {
+            // Until a starting wheel has ticked twice its speed is unknown,
+            // and the integral would wind up on the wait
+            wheel.pid.reset();
+            motors->setTrim(w, 0);
+            continue;
+        }
+        float out = wheel.pid.update(wheel.setpoint / fullSpeed, wheel.speed / fullSpeed, elapsed / 1000.0f);
+        // The PID works in signed speed, the trim along the wheel's direction
+        motors->setTrim(w, (int)lroundf((duty > 0 ? out : -out) * BoardMotors::MAX_DUTY));
+    }
+}
+
+// Ticks over the time between the last tick of the previous step and the
+// last tick of this one, so a tick or two per step still gives a usable
+// speed. With no tick this step, the speed can be at most one tick over
+// the time since the last, which brings it down to 0 as a wheel stops.
+// Slower than a tick per STALE_TICK reads as 0.
+float WheelSpeedControl::measure(Wheel &wheel, uint8_t index) {
+    uint32_t at;
+    int32_t ticks = encoders->getTicks(index, at);
+    float tickLength = odometry->getCalibration().tickLength;  // um
+    int32_t delta = ticks - wheel.lastTicks;
+    uint32_t span = at - wheel.lastTickAt;
+    wheel.lastTicks = ticks;
+
+    if (delta != 0) {
+        // After a standstill the first tick only sets the reference
+        bool timed = wheel.ticked && span > 0 && span < STALE_TICK * 1000;
+        wheel.lastTickAt = at;
+        wheel.ticked = true;
+        if (!timed) return 0;
+        wheel.measured = true;
+        return delta * tickLength * 1000.0f / span;
+    }
+    uint32_t since = micros() - wheel.lastTickAt;
+    if (!wheel.ticked || since >= STALE_TICK * 1000) {
+        wheel.ticked = false;
+        return 0;
+    }
+    float bound = tickLength * 1000.0f / max(since, (uint32_t)1);
+    return constrain(wheel.speed, -bound, bound);
+}
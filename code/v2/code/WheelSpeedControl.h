@@ -0,0 +1,56 @@
+#ifndef WHEEL_SPEED_CONTROL_H
+#define WHEEL_SPEED_CONTROL_H
+
+#include "MotorController.h"
+#include "Odometry.h"
+#include "PidController.h"
+#include "WheelEncoders.h"
+
+// Closes the loop on each wheel's speed. The setpoint is what the odometry
+// model expects at the wheel's ramped duty; the encoders measure what it
+// does. A PID per wheel trims the duty until the two agree, so a weak
+// motor or a sagging battery no longer bends a straight line. Speeds are
+// taken as a fraction of the calibrated maxSpeed and trims as a fraction
+// of MAX_DUTY, so the gains hold on either board.
+class WheelSpeedControl {
+  public:
+    static const unsigned long INTERVAL = 20;  // ms between loop steps
+
+  private:
+    struct Wheel {
+      PidController pid;
+      int32_t lastTicks;
+      uint32_t lastTickAt;      // micros() of the tick lastTicks ends on
+      bool ticked;              // lastTickAt is a recent tick, not just a reference
+      float setpoint;           // mm/s
+      float speed;              // mm/s, measured
+      bool measured;            // two ticks close enough to time since the wheel started
+    };
+
+    BoardMotors* motors;
+    BoardEncoders* encoders;
+    Odometry* odometry;
+    Wheel wheels[2];
+    bool enabled;
+    unsigned long lastUpdate;
+    const unsigned long STALE_TICK = 250;  // ms without a tick that reads as stopped
+
+    float measure(Wheel &wheel, uint8_t index);
+    void release();
+
+  public:
+    WheelSpeedControl(BoardMotors* m, BoardEncoders* e, Odometry* o);
+    // Turns the loop on when the encoders are fitted
+    void begin();
+    void update();
+    void enable(bool on);
+    bool isEnabled() { return enabled; }
+    void setGains(float p, float i, float d);
+    float getKp() const { return wheels[0].pid.getKp(); }
+    float getKi() const { return wheels[0].pid.getKi(); }
+    float getKd() const { return wheels[0].pid.getKd(); }
+    float getSetpoint(uint8_t wheel) { return wheels[wheel].setpoint; }
+    float getSpeed(uint8_t wheel) { return wheels[wheel].speed; }
+};
+
+#endif
@@ -15,11 +15,24 @@
 #endif
 
 // Includes: General
+#include "BoardConfig.h"
 #include "MotorController.h"
 #include "UltrasonicSensor.h"
 #include "ObstacleAvoidance.h"
 #include "RobotArm.h"
-#include "ui_index.h"
+#include "CommandQueue.h"
+#include "Seqlock.h"
+#include "DriveLease.h"
+#include "CommandSchedule.h"
+#include "TeleopMailbox.h"
+#include "SensorTrace.h"
+#include "SensorArray.h"
+#include "WheelEncoders.h"
+#include "Odometry.h"
+#include "WaypointDriver.h"
+#include "WheelSpeedControl.h"
+#include <WebSocketsServer.h>
+#include <WiFiUdp.h>
 #include <EEPROM.h>
 #include "setup_ui.h"
 #include "main_ui.h"
@@ -38,26 +51,123 @@ constexpr size_t MAX_SSID_LENGTH = 32;
 constexpr size_t MAX_PASS_LENGTH = 64;
 constexpr size_t MAX_MDNS_LENGTH = 32;
 
-// Constants: Pin Definitions
-#if defined(ESP32)
-    constexpr uint8_t MOTOR1_IN1 = 5, MOTOR1_IN2 = 4, MOTOR2_IN1 = 18, MOTOR2_IN2 = 19;
-    constexpr uint8_t MOTOR1_ENA = 32, MOTOR2_ENB = 33, TRIG_PIN = 25, ECHO_PIN = 26;
-    constexpr uint8_t BASE_PIN = 27, SHOULDER_PIN = 14, ELBOW_PIN = 12, GRIPPER_PIN = 13;
-#else
-    constexpr uint8_t MOTOR1_IN1 = 5, MOTOR1_IN2 = 4, MOTOR2_IN1 = 0, MOTOR2_IN2 = 2;
-    constexpr uint8_t MOTOR1_ENA = 14, MOTOR2_ENB = 12, TRIG_PIN = 13, ECHO_PIN = 15;
-    constexpr uint8_t BASE_PIN = 16, SHOULDER_PIN = 3, ELBOW_PIN = 1, GRIPPER_PIN = 9;
-#endif
+// Constants: Control Loop
+constexpr int JOG_SPEED = 45;  // Default jog velocity in degrees per second
+constexpr uint32_t CONTROL_TASK_STACK = 8192;
+constexpr uint32_t NETWORK_TASK_STACK = 8192;
+constexpr uint32_t CONTROL_IDLE_WAIT = 20;  // ms the control task sleeps when parked
+
+// Constants: Teleop Stream
+constexpr uint16_t TELEOP_PORT = 81;       // WebSocket, next to the HTTP server
+constexpr uint32_t TELEOP_MAX_AGE = 250;   // ms; older stick frames are dropped
+constexpr int TELEOP_JOG_SPEED = 90;       // deg/s at full arm stick
+
+// Constants: Command Results
+// Per-command status shared by UDP acks and the /batch result vector
+enum CommandStatus : uint8_t {
+    COMMAND_OK,
+    COMMAND_FULL,       // queue or schedule full
+    COMMAND_STALE,      // duplicate or out of order, not run
+    COMMAND_INVALID
+};
+
+// Constants: UDP Control (define NO_UDP_CONTROL to leave the listener out)
+// Datagram: uint32 sequence (little-endian), uint8 flags, command text.
+// Ack: the same sequence and one status byte.
+constexpr uint16_t UDP_CONTROL_PORT = 4210;
+constexpr size_t UDP_HEADER_SIZE = 5;
+constexpr uint8_t UDP_FLAG_ACK = 0x01;      // sender wants an ack
+constexpr uint8_t UDP_MAX_PACKETS = 8;      // per network pass
+
+// Constants: Deadman Lease
+constexpr uint32_t LEASE_DEFAULT = 500;    // ms a drive command stays valid without "hb"
+
+// Constants: Pin Definitions live in BoardConfig.h (Board::Pins)
 // Constants end
 
 // Variables
 String wifiSSID, wifiPassword, mdnsName;
 
+// Types: Control Loop
+// Written by the control loop, read by the network side
+struct RobotState {
+    int speed;
+    int leftDuty;
+    int rightDuty;
+    float distance;
+    uint32_t samples;
+    unsigned long sampleInterval;
+    float sampleRate;
+    bool samplingIdle;
+    float alertThreshold;
+    bool alertNear;
+    uint32_t alertEvents;
+    float timeToCollision;
+    float governor;
+    bool oaActive;
+    bool navigating;
+    uint8_t navMode;
+    float heading;
+    float wallDistance;
+    uint8_t armJob;
+    uint8_t routeState;
+    uint8_t routeLeft;
+    bool wheelLoop;
+    float wheelSetpoint[2];
+    float wheelSpeed[2];
+    int wheelTrim[2];
+    bool leaseHeld;
+    uint32_t leaseExpired;
+    BoardMotors::OutputStats outputs;
+    unsigned long timestamp;
+};
+
 // Objects
-MotorController motors(MOTOR1_IN1, MOTOR1_IN2, MOTOR2_IN1, MOTOR2_IN2, MOTOR1_ENA, MOTOR2_ENB);
-UltrasonicSensor sensor(TRIG_PIN, ECHO_PIN);
+BoardMotors motors;
+BoardSensor sensor;
+BoardSensorArray sensorArray;
 ObstacleAvoidance oa(&motors, &sensor);
-RobotArm arm(BASE_PIN, SHOULDER_PIN, ELBOW_PIN, GRIPPER_PIN);
+BoardEncoders encoders;
+Odometry odometry(&motors, &encoders);
+WaypointDriver route(&motors, &odometry);
+WheelSpeedControl wheels(&motors, &encoders, &odometry);
+BoardArm arm;
+CommandQueue commandQueue;
+CommandSchedule commandSchedule;
+Seqlock<RobotState> robotState;
+WebSocketsServer teleopSocket(TELEOP_PORT);
+TeleopMailbox teleop;
+bool teleopDriving = false;   // control side: the stick owns the wheels
+bool teleopJogging = false;   // control side: the stick owns the arm jog
+#if DUAL_CORE_CONTROL
+TaskHandle_t controlTaskHandle = NULL;  // woken early by commands and stick frames
+#endif
+
+DriveLease lease(LEASE_DEFAULT);
+
+// Distance stream: telemetry and the user alert subscribe next to OA
+DistanceSample lastSample = {0, 0, 0};
+uint32_t sampleCount = 0;
+int8_t alertId = -1;
+float alertThreshold = 0;   // cm, 0 = off
+bool alertNear = false;
+uint32_t alertEvents = 0;
+SensorTrace sensorTrace;    // raw echoes for host replay, see code/v2/sim
+
+#ifndef NO_UDP_CONTROL
+// UDP control: network side only. Sequence numbers are tracked for the
+// latest sender; a new address or port starts a new session.
+WiFiUDP controlUdp;
+IPAddress udpPeer;
+uint16_t udpPeerPort = 0;
+uint32_t udpLastSequence = 0;
+struct UdpStats {
+    uint32_t received;
+    uint32_t accepted;
+    uint32_t stale;
+    uint32_t invalid;
+} udpStats = {0, 0, 0, 0};
+#endif
 
 // Function Declarations
 void saveSettingsToEEPROM();
@@ -68,14 +178,45 @@ void setupMDNS();
 void handleRoot();
 void handleCommand();
 void handleSetup();
+void handleTelemetry();
+String arrayJson();
+String poseJson();
+String wheelsJson();
+void handleTeleopEvent(uint8_t client, WStype_t type, uint8_t *payload, size_t length);
+bool parseTeleopFrame();
+void applyTeleop();
+void takeManualDrive();
+bool dispatchCommand();
+void udpStep();
+void handleBatch();
+uint8_t scheduleBatchLine();
+void batchStep();
+void sendUdpAck();
+void checkLease();
+void onDistanceSample(void *context, int8_t id, DistanceEvent event, const DistanceSample &sample);
+void onDistanceAlert(void *context, int8_t id, DistanceEvent event, const DistanceSample &sample);
+void onTraceSample(void *context, int8_t id, DistanceEvent event, const DistanceSample &sample);
+void handleTrace();
+void startTrace();
 void setupHTTPRoutes();
 void writeStringToEEPROM();
 String readStringFromEEPROM();
 void executeCommand();
 void handleArmCommands();
 void startNavigationMode();
+void startRoute();
+uint8_t parseNumbers();
 void processMovementOrSave();
 void processArmMovement();
+void processArmJobControl();
+void processJog();
+bool enqueueCommand();
+void wakeControl();
+bool controlIdle();
+void controlStep();
+void publishState();
+void networkStep();
+bool motionWaitHook();
 
 // Helper Functions: EEPROM
 void writeStringToEEPROM(int addr, const String &data) {
@@ -115,7 +256,14 @@ void loadSettingsFromEEPROM() {
 
 // Functions: Web Server Handlers
 void handleRoot() {
-    String uiPage = WiFi.status() == WL_CONNECTED ? REMOTE_UI : SETUP_UI;
+    if (WiFi.status() != WL_CONNECTED) {
+        server.send(200, "text/html", SETUP_UI);
+        return;
+    }
+    // The speed slider follows the motor PWM resolution of this board
+    String uiPage = MAIN_UI;
+    uiPage.replace("%PWM_MAX%", String(BoardMotors::MAX_DUTY));
+    uiPage.replace("%SPEED%", String(robotState.read().speed));
     server.send(200, "text/html", uiPage);
 }
 
@@ -136,10 +284,288 @@ void handleSetup() {
 
 void handleCommand() {
     String cmd = server.arg("cmd");
-    executeCommand(cmd);
-    server.send(200, "text/plain", "Command received: " + cmd);
+    if (dispatchCommand(cmd)) {
+        server.send(200, "text/plain", "Command received: " + cmd);
+    } else {
+        server.send(503, "text/plain", "Command queue full: " + cmd);
+    }
+}
+
+// Raw trace download: the header, then the entries recorded so far. Replay
+// it with code/v2/sim/trace_replay.
+void handleTrace() {
+    uint16_t count = sensorTrace.size();
+    server.setContentLength(sizeof(TraceHeader) + count * sizeof(TraceEntry));
+    server.send(200, "application/octet-stream", "");
+    server.sendContent((const char *)&sensorTrace.getHeader(), sizeof(TraceHeader));
+    server.sendContent((const char *)sensorTrace.getEntries(), count * sizeof(TraceEntry));
+}
+
+// Body: one command per line, each optionally prefixed "+<ms> " to run that
+// long after the batch arrived. Replies with one status per command.
+void handleBatch() {
+    String body = server.arg("plain");
+    uint32_t now = millis();
+    String results = "[";
+    unsigned int count = 0;
+    unsigned int start = 0;
+    while (start < body.length()) {
+        int end = body.indexOf('\n', start);
+        if (end < 0) end = body.length();
+        String line = body.substring(start, end);
+        start = end + 1;
+        line.trim();
+        if (line.length() == 0) continue;
+        if (count++) results += ',';
+        results += String(scheduleBatchLine(line, now));
+    }
+    server.send(200, "application/json", results + "]");
+}
+
+uint8_t scheduleBatchLine(String line, uint32_t now) {
+    uint32_t offset = 0;
+    if (line.charAt(0) == '+') {
+        int split = line.indexOf(' ');
+        if (split < 2) return COMMAND_INVALID;
+        for (int i = 1; i < split; ++i) {
+            if (!isDigit(line.charAt(i))) return COMMAND_INVALID;
+        }
+        offset = line.substring(1, split).toInt();
+        line = line.substring(split + 1);
+        line.trim();
+    }
+    if (line.length() == 0 || line.length() >= QueuedCommand::MAX_LENGTH) return COMMAND_INVALID;
+    return commandSchedule.add(line.c_str(), now + offset) ? COMMAND_OK : COMMAND_FULL;
+}
+
+// Latest sensor array round: distances in cm and measured readings per second
+String arrayJson() {
+    BoardSensorArray::Snapshot snapshot = sensorArray.getSnapshot();
+    String distances, rates;
+    for (uint8_t i = 0; i < snapshot.count; i++) {
+        if (i > 0) {
+            distances += ",";
+            rates += ",";
+        }
+        distances += String(snapshot.distance[i]);
+        rates += String(snapshot.rate[i]);
+    }
+    return "{\"round\":" + String(snapshot.round) +
+           ",\"interval\":" + String(sensorArray.getInterval()) +
+           ",\"d\":[" + distances + "],\"hz\":[" + rates + "]}";
+}
+
+// Odometry pose in cm and degrees
+String poseJson() {
+    Odometry::Pose pose = odometry.getPose();
+    return "{\"x\":" + String(Odometry::toCm(pose.x)) +
+           ",\"y\":" + String(Odometry::toCm(pose.y)) +
+           ",\"theta\":" + String(Odometry::toDegrees(pose.theta)) +
+           ",\"encoders\":" + String(odometry.usingEncoders() ? "true" : "false") + "}";
+}
+
+// Speed loop per wheel: setpoint and measured speed in mm/s, trim in duty
+String wheelsJson(bool loop, const float *setpoint, const float *speed, const int *trim) {
+    String json = "{\"loop\":" + String(loop ? "true" : "false");
+    const char *names[2] = {"left", "right"};
+    for (uint8_t w = 0; w < 2; w++) {
+        json += ",\"" + String(names[w]) + "\":{\"set\":" + String(setpoint[w], 0) +
+                ",\"speed\":" + String(speed[w], 0) +
+                ",\"trim\":" + String(trim[w]) + "}";
+    }
+    return json + "}";
+}
+
+void handleTelemetry() {
+    RobotState state = robotState.read();
+    CommandQueue::Stats queue = commandQueue.getStats();
+    TeleopMailbox::Stats stream = teleop.getStats();
+    String json = "{\"speed\":" + String(state.speed) +
+                  ",\"left\":" + String(state.leftDuty) +
+                  ",\"right\":" + String(state.rightDuty) +
+                  ",\"distance\":" + String(state.distance) +
+                  ",\"samples\":" + String(state.samples) +
+                  ",\"sampling\":{\"interval\":" + String(state.sampleInterval) +
+                  ",\"hz\":" + String(state.sampleRate) +
+                  ",\"idle\":" + String(state.samplingIdle ? "true" : "false") + "}" +
+                  ",\"alert\":{\"threshold\":" + String(state.alertThreshold) +
+                  ",\"near\":" + String(state.alertNear ? "true" : "false") +
+                  ",\"events\":" + String(state.alertEvents) + "}" +
+                  ",\"ttc\":" + String(state.timeToCollision) +
+                  ",\"governor\":" + String(state.governor) +
+                  ",\"oa\":" + String(state.oaActive ? "true" : "false") +
+                  ",\"nav\":" + String(state.navigating ? "true" : "false") +
+                  ",\"navMode\":" + String(state.navMode) +
+                  ",\"heading\":" + String(state.heading) +
+                  ",\"wall\":" + String(state.wallDistance) +
+                  ",\"armJob\":" + String(state.armJob) +
+                  ",\"pose\":" + poseJson() +
+                  ",\"route\":{\"state\":" + String(state.routeState) +
+                  ",\"left\":" + String(state.routeLeft) + "}" +
+                  ",\"wheels\":" + wheelsJson(state.wheelLoop, state.wheelSetpoint, state.wheelSpeed, state.wheelTrim) +
+                  ",\"writes\":{\"direction\":" + String(state.outputs.directionWrites) +
+                  ",\"directionSkipped\":" + String(state.outputs.directionSkipped) +
+                  ",\"duty\":" + String(state.outputs.dutyWrites) +
+                  ",\"dutySkipped\":" + String(state.outputs.dutySkipped) + "}" +
+                  ",\"lease\":{\"window\":" + String(lease.getWindow()) +
+                  ",\"held\":" + String(state.leaseHeld ? "true" : "false") +
+                  ",\"expired\":" + String(state.leaseExpired) + "}" +
+                  ",\"t\":" + String(state.timestamp) +
+                  ",\"queue\":{\"depth\":" + String(queue.depth) +
+                  ",\"maxDepth\":" + String(queue.maxDepth) +
+                  ",\"accepted\":" + String(queue.accepted) +
+                  ",\"dropped\":" + String(queue.dropped) +
+                  ",\"coalesced\":" + String(queue.coalesced) +
+                  ",\"preemptions\":" + String(queue.preemptions) +
+                  ",\"flushed\":" + String(queue.flushed) +
+                  ",\"latencyUs\":" + String(queue.lastLatencyUs) +
+                  ",\"maxLatencyUs\":" + String(queue.maxLatencyUs) + "}" +
+                  ",\"teleop\":{\"posted\":" + String(stream.posted) +
+                  ",\"taken\":" + String(stream.taken) +
+                  ",\"stale\":" + String(stream.stale) +
+                  ",\"overwritten\":" + String(stream.overwritten) +
+                  ",\"expired\":" + String(stream.expired) +
+                  ",\"ageMs\":" + String(stream.lastAgeMs) + "}" +
+                  ",\"batch\":{\"pending\":" + String(commandSchedule.size()) + "}" +
+                  ",\"trace\":{\"recording\":" + String(sensorTrace.isRecording() ? "true" : "false") +
+                  ",\"entries\":" + String(sensorTrace.size()) + "}" +
+                  ",\"array\":" + arrayJson() +
+#ifndef NO_UDP_CONTROL
+                  ",\"udp\":{\"received\":" + String(udpStats.received) +
+                  ",\"accepted\":" + String(udpStats.accepted) +
+                  ",\"stale\":" + String(udpStats.stale) +
+                  ",\"invalid\":" + String(udpStats.invalid) + "}" +
+#endif
+                  "}";
+    server.send(200, "application/json", json);
+}
+
+void setupHTTPRoutes() {
+    server.on("/", handleRoot);
+    server.on("/setup", handleSetup);
+    server.on("/command", handleCommand);
+    server.on("/telemetry", handleTelemetry);
+    server.on("/batch", HTTP_POST, handleBatch);
+    server.on("/trace", handleTrace);
+    server.onNotFound(handleRoot);  // Captive portal in AP mode
+
+    teleop.setMaxAge(TELEOP_MAX_AGE);
+    teleopSocket.onEvent(handleTeleopEvent);
+    teleopSocket.begin();
+}
+
+// Functions: Teleop Stream
+// Frame: "<time> <linear> <angular> <base> <shoulder> <elbow> <gripper>",
+// time in sender ms, axes -100..100. Missing arm axes read as 0.
+bool parseTeleopFrame(const char *text, TeleopInput &input) {
+    char *end;
+    input.clientTime = strtoul(text, &end, 10);
+    if (end == text) return false;
+
+    long axes[2 + TeleopInput::ARM_AXES] = {0};
+    for (uint8_t i = 0; i < 2 + TeleopInput::ARM_AXES; ++i) {
+        const char *start = end;
+        axes[i] = constrain(strtol(start, &end, 10), -100L, 100L);
+        if (end == start) {
+            if (i < 2) return false;  // drive axes are required
+            break;
+        }
+    }
+    input.linear = axes[0];
+    input.angular = axes[1];
+    for (uint8_t i = 0; i < TeleopInput::ARM_AXES; ++i) {
+        input.arm[i] = axes[2 + i];
+    }
+    return true;
+}
+
+// Network side: frames go to the mailbox, never the command queue
+void handleTeleopEvent(uint8_t client, WStype_t type, uint8_t *payload, size_t length) {
+    switch (type) {
+        case WStype_CONNECTED:
+            teleop.reset();
+            break;
+        case WStype_DISCONNECTED:
+            // Don't leave the robot driving on the last stick position
+            enqueueCommand("vel 0 0");
+            enqueueCommand("jb0");
+            break;
+        case WStype_TEXT: {
+            if (length == 1 && payload[0] == 'h') {
+                lease.renew();  // stick held still: heartbeat instead of a frame
+                break;
+            }
+            char frame[64];
+            size_t n = min(length, sizeof(frame) - 1);
+            memcpy(frame, payload, n);
+            frame[n] = '\0';
+            TeleopInput input;
+            if (parseTeleopFrame(frame, input)) {
+                teleop.post(input);
+                wakeControl();
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+// Functions: UDP Control
+#ifndef NO_UDP_CONTROL
+void sendUdpAck(uint32_t sequence, uint8_t status) {
+    uint8_t ack[UDP_HEADER_SIZE] = {
+        (uint8_t)sequence, (uint8_t)(sequence >> 8), (uint8_t)(sequence >> 16), (uint8_t)(sequence >> 24),
+        status
+    };
+    controlUdp.beginPacket(controlUdp.remoteIP(), controlUdp.remotePort());
+    controlUdp.write(ack, sizeof(ack));
+    controlUdp.endPacket();
 }
 
+// Network side: drains a bounded number of datagrams into the dispatcher
+void udpStep() {
+    for (uint8_t i = 0; i < UDP_MAX_PACKETS; ++i) {
+        int size = controlUdp.parsePacket();
+        if (size <= 0) return;
+        udpStats.received++;
+
+        uint8_t packet[UDP_HEADER_SIZE + QueuedCommand::MAX_LENGTH];
+        int length = controlUdp.read(packet, sizeof(packet) - 1);
+        if (length < (int)UDP_HEADER_SIZE) {
+            udpStats.invalid++;  // too short to ack
+            continue;
+        }
+        uint32_t sequence = packet[0] | (packet[1] << 8) | (packet[2] << 16) | ((uint32_t)packet[3] << 24);
+        bool wantsAck = packet[4] & UDP_FLAG_ACK;
+
+        uint8_t status;
+        IPAddress ip = controlUdp.remoteIP();
+        uint16_t port = controlUdp.remotePort();
+        bool sameSession = ip == udpPeer && port == udpPeerPort;
+        if (size > length || length == (int)UDP_HEADER_SIZE) {
+            udpStats.invalid++;
+            status = COMMAND_INVALID;
+        } else if (sameSession && (int32_t)(sequence - udpLastSequence) <= 0) {
+            udpStats.stale++;
+            status = COMMAND_STALE;
+        } else {
+            packet[length] = '\0';
+            status = dispatchCommand(String((const char *)packet + UDP_HEADER_SIZE)) ? COMMAND_OK : COMMAND_FULL;
+            // Only a command that went in uses up its number, so a retry
+            // after FULL is tried again instead of acked STALE
+            if (status == COMMAND_OK) {
+                udpPeer = ip;
+                udpPeerPort = port;
+                udpLastSequence = sequence;
+                udpStats.accepted++;
+            }
+        }
+        if (wantsAck) sendUdpAck(sequence, status);
+    }
+}
+#endif
+
 // Functions: Networking
 void setupAccessPoint() {
     WiFi.softAP("ConfigAP", "12345678");
@@ -177,24 +603,128 @@ void setupMDNS() {
 // Fucntion Movement
 // Helper Function: Body
 void executeCommand(String command) {
-    if (command == "mv") { motors.moveForward(); }
-    else if (command == "bk") { motors.moveBackward(); }
-    else if (command == "lt") { motors.turnLeft(); }
-    else if (command == "rt") { motors.turnRight(); }
-    else if (command == "rl") { motors.rotateLeft(); }
-    else if (command == "rr") { motors.rotateRight(); }
-    else if (command == "st") { motors.stop(); }
+    if (command == "mv") { takeManualDrive(); motors.moveForward(); lease.grant(); }
+    else if (command == "bk") { takeManualDrive(); motors.moveBackward(); lease.grant(); }
+    else if (command == "lt") { takeManualDrive(); motors.turnLeft(); lease.grant(); }
+    else if (command == "rt") { takeManualDrive(); motors.turnRight(); lease.grant(); }
+    else if (command == "rl") { takeManualDrive(); motors.rotateLeft(); lease.grant(); }
+    else if (command == "rr") { takeManualDrive(); motors.rotateRight(); lease.grant(); }
+    else if (command == "st") { oa.stopNavigation(); route.cancel(); motors.stop(); arm.abort(); lease.release(); }
+    else if (command.startsWith("vel ")) {
+        // vel <linear> <angular>, both -1..1
+        int split = command.indexOf(' ', 4);
+        float linear = command.substring(4).toFloat();
+        float angular = split > 0 ? command.substring(split + 1).toFloat() : 0.0f;
+        takeManualDrive();
+        motors.setVelocity(linear, angular);
+        if (linear != 0.0f || angular != 0.0f) lease.grant();
+        else lease.release();
+    }
+    else if (command == "hb") { lease.renew(); }
+    else if (command.startsWith("lease ")) {
+        // lease <ms>: deadman window for drive commands, 0 turns it off
+        lease.setWindow(command.substring(6).toInt());
+    }
     else if (command.startsWith("spd ")) {
+        // 0..BoardMotors::MAX_DUTY (255 on ESP8266, 1023 with LEDC on ESP32)
         int speed = command.substring(4).toInt();
         motors.setSpeed(speed);
     }
     else if (command == "oa on") { oa.enable(); }
     else if (command == "oa off") { oa.disable(); }
-    else if (command == "oa nav") { startNavigationMode(); }
+    else if (command == "oa nav") { startNavigationMode(ObstacleAvoidance::NAV_RIGHT_TURN); }
+    else if (command == "oa scan") { startNavigationMode(ObstacleAvoidance::NAV_SCAN); }
+    else if (command.startsWith("oa wall")) {
+        // oa wall [target_cm] [speed] [sensor_angle]: follow a wall; omitted values keep their setting
+        float values[3] = {0, 0, 0};
+        int start = 7;
+        for (int i = 0; i < 3 && start > 0 && start < (int)command.length(); i++) {
+            values[i] = command.substring(start + 1).toFloat();
+            start = command.indexOf(' ', start + 1);
+        }
+        oa.setWallFollowing(values[0], values[1], values[2]);
+        startNavigationMode(ObstacleAvoidance::NAV_WALL);
+    }
+    else if (command.startsWith("oa pid ")) {
+        // oa pid <kp> <ki> <kd>: wall-following gains
+        int first = command.indexOf(' ', 7);
+        int second = first > 0 ? command.indexOf(' ', first + 1) : -1;
+        if (second > 0) {
+            oa.setWallGains(command.substring(7).toFloat(),
+                            command.substring(first + 1).toFloat(),
+                            command.substring(second + 1).toFloat());
+        }
+    }
+    else if (command.startsWith("oa rate ")) {
+        // oa rate <deg/s>: spin rate at full duty, calibrates scan headings
+        oa.setRotationRate(command.substring(8).toFloat());
+    }
+    else if (command.startsWith("oa ttc ")) {
+        // oa ttc <brake_s> <turn_s>: predicted-impact times for braking and turning
+        int split = command.indexOf(' ', 7);
+        float brake = command.substring(7).toFloat();
+        float turn = split > 0 ? command.substring(split + 1).toFloat() : brake * 2;
+        if (!oa.setTimeToCollision(brake, turn)) Serial.println("Invalid TTC: need 0 < brake < turn.");
+    }
+    else if (command.startsWith("goto ")) {
+        // goto <x> <y> [<x> <y> ...]: drive through waypoints, cm in the odometry frame
+        float values[2 * WaypointDriver::MAX_WAYPOINTS];
+        uint8_t n = parseNumbers(command, 4, values, 2 * WaypointDriver::MAX_WAYPOINTS);
+        route.clear();
+        for (uint8_t i = 0; i + 1 < n; i += 2) route.add(values[i], values[i + 1]);
+        startRoute();
+    }
+    else if (command.startsWith("odo reset")) {
+        // odo reset [x y heading]: cm, cm, degrees; the pose is the origin without them
+        float values[3] = {0, 0, 0};
+        parseNumbers(command, 9, values, 3);
+        odometry.reset(values[0], values[1], values[2]);
+    }
+    else if (command.startsWith("odo cal ")) {
+        // odo cal <cm/s> <wheelbase_cm> [stall_duty] [lag_ms]: duty-to-speed model
+        float values[4] = {0, 0, -1, -1};
+        if (parseNumbers(command, 7, values, 4) >= 2) {
+            Odometry::Calibration c = odometry.getCalibration();
+            c.maxSpeed = values[0] * 10;
+            c.wheelBase = values[1] * 10;
+            if (values[2] >= 0) c.stallDuty = values[2];
+            if (values[3] >= 0) c.lag = values[3];
+            odometry.setCalibration(c);
+        }
+    }
+    else if (command.startsWith("odo tick ")) {
+        // odo tick <mm>: wheel travel per encoder tick
+        Odometry::Calibration c = odometry.getCalibration();
+        c.tickLength = command.substring(9).toFloat() * 1000;
+        odometry.setCalibration(c);
+    }
+    else if (command == "wheel on" || command == "wheel off") {
+        // wheel on|off: closed-loop wheel speed, needs the encoders
+        wheels.enable(command == "wheel on");
+        if (command == "wheel on" && !wheels.isEnabled()) Serial.println("No wheel encoders (build with WHEEL_ENCODERS), speed loop stays off");
+    }
+    else if (command.startsWith("wheel pid ")) {
+        // wheel pid <kp> <ki> <kd>: speed loop gains, on fractions of full speed and duty
+        float values[3];
+        if (parseNumbers(command, 9, values, 3) == 3) wheels.setGains(values[0], values[1], values[2]);
+    }
     else if (command == "dist") {
         float distance = sensor.getFilteredDistance(5);
         Serial.println("Distance: " + String(distance) + " cm"); 
     }
+    else if (command.startsWith("alert ")) {
+        // alert <cm>: report crossings of this distance, 0 turns it off
+        alertThreshold = max(command.substring(6).toFloat(), 0.0f);
+        if (alertThreshold <= 0) alertNear = false;
+        sensor.setThreshold(alertId, alertThreshold, 5.0f);  // reports a crossing at once
+    }
+    else if (command.startsWith("array ")) {
+        // array <ms>: least time between two readings of one array sensor
+        sensorArray.setInterval(max(command.substring(6).toInt(), 0L));
+    }
+    else if (command == "trace on") { startTrace(); }
+    else if (command == "trace off") { sensorTrace.stop(); }
+    else if (command == "bench") { motors.benchmarkDirection(1000); }
     else if (command == "stream") { arm.startRecording(); }
     else if (command.length() >= 3) { handleArmCommands(command); }
     else { Serial.println("Invalid Command."); }
@@ -208,18 +738,65 @@ void handleArmCommands(String command) {
     switch (type) {
         case 'b': case 's': case 'e': arm.moveJoint(type, action); break;
         case 'g': arm.moveGripper(action); break;
+        case 'a': processArmJobControl(action); break;
+        case 'j': processJog(command); break;
         case 'm': processMovementOrSave(command, action); break;
         case 'p': if (action == 's') arm.printSavedPositions(); break;
     }
 }
 
+// Helper Function: Manual Drive
+// Buttons, vel and the stick all take the wheels from navigation or a route
+void takeManualDrive() {
+    oa.stopNavigation();
+    route.cancel();
+}
+
 // Helper Function: Navigation
-void startNavigationMode() {
-    oa.enable();
-    while (oa.isActive()) {
-        oa.navigate();
+// Runs from the control loop until "st" or "oa off"
+void startNavigationMode(ObstacleAvoidance::NavMode mode) {
+    lease.release();  // autonomous driving needs no heartbeat
+    route.cancel();
+    oa.startNavigation(mode);
+}
+
+// Runs from the control loop until the last waypoint, "st" or a stick frame
+void startRoute() {
+    lease.release();
+    oa.stopNavigation();
+    route.start();
+}
+
+// Reads up to maxValues space-separated numbers after position start
+uint8_t parseNumbers(const String &command, int start, float *values, uint8_t maxValues) {
+    uint8_t n = 0;
+    while (n < maxValues && start >= 0 && start < (int)command.length()) {
+        values[n++] = command.substring(start + 1).toFloat();
+        start = command.indexOf(' ', start + 1);
     }
-    motors.stop();
+    return n;
+}
+
+// Helper Function: Trace
+// Navigation restarts from a standstill, so the replay can begin from the
+// same state as the recording
+void startTrace() {
+    TraceHeader settings = {};
+    settings.navMode = oa.getNavMode();
+    settings.flags = oa.isActive() ? TRACE_OA_ACTIVE : 0;
+    settings.speed = motors.getSpeed();
+    settings.maxDuty = BoardMotors::MAX_DUTY;
+    settings.rotationRate = oa.getRotationRate() * 10 + 0.5f;
+    settings.wallTarget = oa.getWallTarget();
+    settings.wallSpeed = oa.getWallSpeed() * 100;
+    settings.wallAngle = oa.getWallAngle();
+    if (oa.navigating()) {
+        settings.flags |= TRACE_NAVIGATING;
+        motors.halt();
+        oa.startNavigation(oa.getNavMode());
+    }
+    sensorTrace.start(settings, millis());
+    Serial.printf("Trace recording, up to %u samples\n", SensorTrace::CAPACITY);
 }
 
 // Helper Function: Filter
@@ -235,6 +812,39 @@ void processMovementOrSave(String command, char action) {
     }
 }
 
+// Helper Function: Arm Job Control
+void processArmJobControl(char action) {
+    switch (action) {
+        case 'p': arm.pause(); break;
+        case 'r': arm.resume(); break;
+        case 'x': arm.abort(false); break;  // hold at the current angle
+        case 'e': arm.abort(true); break;   // decelerate over a few degrees, then stop
+        default: Serial.println("Invalid Arm Job Command.");
+    }
+}
+
+// Helper Function: Arm Jog
+// "j<joint><dir>[speed]": jb+ starts the base at JOG_SPEED, js-90 runs the
+// shoulder down at 90 deg/s, jb0 releases
+void processJog(String command) {
+    uint8_t joint;
+    switch (command.charAt(1)) {
+        case 'b': joint = ARM_BASE; break;
+        case 's': joint = ARM_SHOULDER; break;
+        case 'e': joint = ARM_ELBOW; break;
+        case 'g': joint = ARM_GRIPPER; break;
+        default: Serial.println("Invalid Jog Joint."); return;
+    }
+
+    int speed = command.length() > 3 ? command.substring(3).toInt() : JOG_SPEED;
+    switch (command.charAt(2)) {
+        case '+': arm.jog(joint, speed); break;
+        case '-': arm.jog(joint, -speed); break;
+        case '0': arm.stopJog(); break;
+        default: Serial.println("Invalid Jog Direction.");
+    }
+}
+
 // Helper Function: Arm Predifined
 void processArmMovement(char movement) {
     switch (movement) {
@@ -250,13 +860,232 @@ void processArmMovement(char movement) {
 }
 // Fucntion Movement End
 
+// Functions: Control Loop
+// Control side: the wheels follow the newest stick frame; the strongest arm
+// axis jogs its joint. Zero input only releases what the stick started, so
+// buttons and queued commands keep working between stick sessions.
+void applyTeleop(const TeleopInput &input) {
+    bool driving = input.linear != 0 || input.angular != 0;
+    if (driving) takeManualDrive();
+    if (driving || teleopDriving) {
+        motors.setVelocity(input.linear / 100.0f, input.angular / 100.0f);
+        if (driving) lease.grant();
+        else lease.release();
+    }
+    teleopDriving = driving;
+
+    uint8_t joint = ARM_BASE;
+    for (uint8_t i = 1; i < TeleopInput::ARM_AXES; ++i) {
+        if (abs(input.arm[i]) > abs(input.arm[joint])) joint = i;
+    }
+    if (input.arm[joint] != 0) {
+        arm.jog(joint, input.arm[joint] * TELEOP_JOG_SPEED / 100);
+        teleopJogging = true;
+    } else if (teleopJogging) {
+        arm.stopJog();
+        teleopJogging = false;
+    }
+}
+
+// Network side: hands a command to the control loop without waiting for it
+bool enqueueCommand(const String &command) {
+    bool queued = commandQueue.push(command.c_str());
+    if (queued) wakeControl();
+    return queued;
+}
+
+// Network side: ends a parked control task's sleep early
+void wakeControl() {
+#if DUAL_CORE_CONTROL
+    if (controlTaskHandle) xTaskNotifyGive(controlTaskHandle);
+#endif
+}
+
+// Network side: the one entry point for HTTP and UDP commands. Heartbeats
+// are answered here so a backed-up queue cannot delay them.
+bool dispatchCommand(const String &command) {
+    if (command == "hb") {
+        lease.renew();
+        return true;
+    }
+    if (command == "st") {
+        commandSchedule.clear();  // stop also cancels a running batch
+    }
+    return enqueueCommand(command);
+}
+
+// Network side: moves due batch commands into the queue, in order
+void batchStep() {
+    if (commandSchedule.feed(commandQueue, lease) > 0) wakeControl();
+}
+
+// Control side: every shared sensor sample, for telemetry
+void onDistanceSample(void *context, int8_t id, DistanceEvent event, const DistanceSample &sample) {
+    lastSample = sample;
+    sampleCount++;
+}
+
+// Control side: threshold crossings of the user's "alert" distance
+void onDistanceAlert(void *context, int8_t id, DistanceEvent event, const DistanceSample &sample) {
+    if (alertThreshold <= 0 || event == DISTANCE_SAMPLE) return;
+    alertNear = event == DISTANCE_NEAR;
+    alertEvents++;
+    Serial.printf("Alert: %s %.1f cm\n", alertNear ? "near" : "clear", sample.distance);
+}
+
+// Control side: each sample's raw echo, next to the duties it arrived to.
+// A trace of navigation ends when navigation does.
+void onTraceSample(void *context, int8_t id, DistanceEvent event, const DistanceSample &sample) {
+    if (!sensorTrace.isRecording()) return;
+    if ((sensorTrace.getHeader().flags & TRACE_NAVIGATING) && !oa.navigating()) {
+        sensorTrace.stop();
+        return;
+    }
+    sensorTrace.record(sample.time, sample.echo,
+                       motors.getDuty(BoardMotors::WHEEL_LEFT), motors.getDuty(BoardMotors::WHEEL_RIGHT));
+}
+
+// Control side, every pass
+void checkLease() {
+    if (oa.navigating() || !lease.expire()) return;
+    teleopDriving = false;
+    motors.stop();
+    Serial.println("Drive lease expired, stopping");
+}
+
+// Runs while an arm or OA motion blocks the control loop. On single-core
+// builds it keeps the network serviced (handlers only enqueue, so this is
+// safe to re-enter). Odometry keeps integrating the maneuver's duties. A
+// pending safety command aborts the motion.
+bool motionWaitHook() {
+#if !DUAL_CORE_CONTROL
+    networkStep();
+#endif
+    odometry.update();
+    wheels.update();
+    return commandQueue.hasSafetyPending();
+}
+
+void publishState() {
+    RobotState state;
+    state.speed = motors.getSpeed();
+    state.leftDuty = motors.getDuty(BoardMotors::WHEEL_LEFT);
+    state.rightDuty = motors.getDuty(BoardMotors::WHEEL_RIGHT);
+    state.distance = lastSample.distance;
+    state.samples = sampleCount;
+    state.sampleInterval = sensor.getReadInterval();
+    state.sampleRate = sensor.getSampleRate();
+    state.samplingIdle = oa.isSamplingIdle();
+    state.alertThreshold = alertThreshold;
+    state.alertNear = alertNear;
+    state.alertEvents = alertEvents;
+    state.timeToCollision = oa.getTimeToCollision();
+    state.governor = motors.getGovernor();
+    state.oaActive = oa.isActive();
+    state.navigating = oa.navigating();
+    state.navMode = oa.getNavMode();
+    state.heading = oa.getHeading();
+    state.wallDistance = oa.getWallDistance();
+    state.armJob = arm.getJobState();
+    state.routeState = route.getState();
+    state.routeLeft = route.remaining();
+    state.wheelLoop = wheels.isEnabled();
+    for (uint8_t w = 0; w < 2; w++) {
+        state.wheelSetpoint[w] = wheels.getSetpoint(w);
+        state.wheelSpeed[w] = wheels.getSpeed(w);
+        state.wheelTrim[w] = motors.getTrim(w);
+    }
+    state.outputs = motors.getOutputStats();
+    state.leaseHeld = lease.isHeld();
+    state.leaseExpired = lease.getExpired();
+    state.timestamp = millis();
+    robotState.write(state);
+}
+
+// Control side: one pass of the real-time loop (commands, motors, OA).
+// Safety commands all run first; at most one normal command runs per pass.
+void controlStep() {
+    QueuedCommand queued;
+    while (commandQueue.hasSafetyPending() && commandQueue.pop(queued)) {
+        executeCommand(String(queued.text));
+    }
+    if (commandQueue.pop(queued)) {
+        executeCommand(String(queued.text));
+    }
+    TeleopInput input;
+    if (teleop.take(input)) {
+        applyTeleop(input);
+    }
+    checkLease();
+    sensor.update();
+    sensorArray.update();
+    motors.update();
+    odometry.update();
+    wheels.update();
+    oa.update();
+    route.update();
+    arm.update();
+    publishState();
+}
+
+void networkStep() {
+    dnsServer.processNextRequest();
+    server.handleClient();
+    teleopSocket.loop();
+    batchStep();
+#ifndef NO_UDP_CONTROL
+    udpStep();
+#endif
+}
+
+// Control side: parked, with the sensors idle and no arm motion, the loop
+// has nothing to do between the slow readings
+bool controlIdle() {
+    return oa.isSamplingIdle() && !route.driving() && !arm.isBusy();
+}
+
+#if DUAL_CORE_CONTROL
+// Sleeps a tick per pass, or up to CONTROL_IDLE_WAIT while parked; a new
+// command or stick frame wakes it at once
+void controlTask(void *param) {
+    for (;;) {
+        controlStep();
+        ulTaskNotifyTake(pdTRUE, controlIdle() ? pdMS_TO_TICKS(CONTROL_IDLE_WAIT) : 1);
+    }
+}
+
+void networkTask(void *param) {
+    for (;;) {
+        networkStep();
+        vTaskDelay(1);
+    }
+}
+#endif
+
 // Main Setup
 void setup() {
     Serial.begin(115200);
     motors.begin();
     sensor.begin();
+    sensor.subscribe(onDistanceSample, NULL);
+    alertId = sensor.subscribe(onDistanceAlert, NULL, 0);
+    sensor.subscribe(onTraceSample, NULL);
+    // Corner sensors, where the board has pins for them. They face 90
+    // degrees apart, so one group fires both.
+    if (Board::Pins::CORNER_LEFT_ECHO != Board::NO_PIN) {
+        sensorArray.addSensor(Board::Pins::CORNER_LEFT_TRIG, Board::Pins::CORNER_LEFT_ECHO, 45, 0);
+        sensorArray.addSensor(Board::Pins::CORNER_RIGHT_TRIG, Board::Pins::CORNER_RIGHT_ECHO, -45, 0);
+    }
+    sensorArray.setLead(&sensor);
+    sensorArray.begin();
     oa.begin();
+    oa.setSensorArray(&sensorArray);
+    encoders.begin(Board::Pins::ENCODER_LEFT, Board::Pins::ENCODER_RIGHT);
+    odometry.begin();
+    wheels.begin();
+    oa.setWaitHook(motionWaitHook);
     arm.begin();
+    arm.setWaitHook(motionWaitHook);
     EEPROM.begin(EEPROM_SIZE);
 
     loadSettingsFromEEPROM();
@@ -268,11 +1097,23 @@ void setup() {
         setupHTTPRoutes();
         server.begin();
     }
+#ifndef NO_UDP_CONTROL
+    controlUdp.begin(UDP_CONTROL_PORT);
+#endif
+    publishState();
+
+#if DUAL_CORE_CONTROL
+    // Control outranks networking so WiFi work cannot delay a motor update
+    xTaskCreatePinnedToCore(controlTask, "control", CONTROL_TASK_STACK, NULL, 3, &controlTaskHandle, Board::CONTROL_CORE);
+    xTaskCreatePinnedToCore(networkTask, "network", NETWORK_TASK_STACK, NULL, 1, NULL, Board::NETWORK_CORE);
+#endif
 }
 
 void loop() {
-    server.handleClient();
-    if (oa.isActive()) {
-        oa.check();
-    }
+#if DUAL_CORE_CONTROL
+    vTaskDelete(NULL);  // Work runs in the pinned tasks
+#else
+    networkStep();
+    controlStep();
+#endif
 }
@@ -95,6 +95,11 @@ const char MAIN_UI[] PROGMEM = R"rawliteral(
             box-shadow: 5px 5px 15px rgba(0, 0, 0, 0.6), -5px -5px 15px rgba(0, 0, 0, 0.3);
         }
 
+        .jog-btn {
+            touch-action: none;
+            user-select: none;
+        }
+
         .joint-control {
             margin: inherit;
         }
@@ -123,12 +128,33 @@ const char MAIN_UI[] PROGMEM = R"rawliteral(
             background-color: var(--detect-button-hover);
         }
 
-        .movement-grid {
-            display: grid;
-            grid-template-columns: repeat(3, 1fr);
-            gap: 10px;
-            max-width: 300px;
-            margin: 20px auto;
+        .stick {
+            position: relative;
+            width: 200px;
+            height: 200px;
+            margin: 20px auto 10px;
+            border-radius: 50%;
+            background-color: var(--primary-dark);
+            border: 2px solid var(--accent-purple);
+            touch-action: none;
+            user-select: none;
+        }
+
+        .stick-knob {
+            position: absolute;
+            left: 50%;
+            top: 50%;
+            width: 70px;
+            height: 70px;
+            border-radius: 50%;
+            background-color: var(--detect-button);
+            transform: translate(-50%, -50%);
+            pointer-events: none;
+        }
+
+        .stick-hint {
+            font-size: 0.6rem;
+            margin-bottom: 15px;
         }
 
         .center-align i {
@@ -194,41 +220,23 @@ const char MAIN_UI[] PROGMEM = R"rawliteral(
                 <div id="BodyControl">
                     <div class="control-card">
                         <h5 class="center-align">Movement Control</h5>
-                        <div class="movement-grid">
-                            <button class="btn-floating waves-effect waves-light" onclick="sendCommand('rl')">
-                                <i class="material-icons">rotate_left</i>
-                            </button>
-                            <button class="btn-floating waves-effect waves-light" onclick="sendCommand('mv')">
-                                <i class="material-icons">arrow_upward</i>
-                            </button>
-                            <button class="btn-floating waves-effect waves-light" onclick="sendCommand('rr')">
-                                <i class="material-icons">rotate_right</i>
-                            </button>
-
-                            <button class="btn-floating waves-effect waves-light" onclick="sendCommand('lt')">
-                                <i class="material-icons">arrow_back</i>
-                            </button>
-                            <button class="btn-floating waves-effect waves-light" onclick="sendCommand('st')">
-                                <i class="material-icons">stop</i>
-                            </button>
-                            <button class="btn-floating waves-effect waves-light" onclick="sendCommand('rt')">
-                                <i class="material-icons">arrow_forward</i>
-                            </button>
-
-                            <div></div>
-                            <button class="btn-floating waves-effect waves-light" onclick="sendCommand('bk')">
-                                <i class="material-icons">arrow_downward</i>
+                        <div class="stick" id="driveStick">
+                            <div class="stick-knob"></div>
+                        </div>
+                        <p class="center-align stick-hint">Drag to drive, or use a gamepad (left stick)</p>
+                        <div class="center-align">
+                            <button class="btn waves-effect waves-light" onclick="sendCommand('st')">
+                                <i class="material-icons left">stop</i>Stop
                             </button>
-                            <div></div>
                         </div>
 
                         <div class="divider"></div>
 
                         <div class="speed-control center-align">
                             <h5>Speed Control</h5>
-                            <p class="slider-label">Speed: <span id="speedValue">128</span></p>
+                            <p class="slider-label">Speed: <span id="speedValue">%SPEED%</span></p>
                             <p class="range-field">
-                                <input type="range" min="0" max="255" value="128"
+                                <input type="range" min="0" max="%PWM_MAX%" value="%SPEED%"
                                     oninput="document.getElementById('speedValue').innerHTML = this.value"
                                     onchange="sendCommand('spd ' + this.value)" />
                             </p>
@@ -254,33 +262,37 @@ const char MAIN_UI[] PROGMEM = R"rawliteral(
                 <div id="ArmControl">
                     <div class="control-card">
                         <h5 class="center-align">Joint Control</h5>
+                        <div class="stick" id="armStick">
+                            <div class="stick-knob"></div>
+                        </div>
+                        <p class="center-align stick-hint">Drag: base / shoulder. Gamepad: right stick, triggers elbow, bumpers gripper</p>
                         <div class="joint-control">
                             <div class="joint-section">
                                 <h6>Base</h6>
-                                <button class="btn waves-effect waves-light" onclick="sendCommand('b -')">
+                                <button class="btn waves-effect waves-light jog-btn" data-jog="b-">
                                     <i class="material-icons">arrow_back</i>
                                 </button>
-                                <button class="btn waves-effect waves-light" onclick="sendCommand('b +')">
+                                <button class="btn waves-effect waves-light jog-btn" data-jog="b+">
                                     <i class="material-icons">arrow_forward</i>
                                 </button>
                             </div>
 
                             <div class="joint-section">
                                 <h6>Shoulder</h6>
-                                <button class="btn waves-effect waves-light" onclick="sendCommand('s -')">
+                                <button class="btn waves-effect waves-light jog-btn" data-jog="s-">
                                     <i class="material-icons">arrow_downward</i>
                                 </button>
-                                <button class="btn waves-effect waves-light" onclick="sendCommand('s +')">
+                                <button class="btn waves-effect waves-light jog-btn" data-jog="s+">
                                     <i class="material-icons">arrow_upward</i>
                                 </button>
                             </div>
 
                             <div class="joint-section">
                                 <h6>Elbow</h6>
-                                <button class="btn waves-effect waves-light" onclick="sendCommand('e -')">
+                                <button class="btn waves-effect waves-light jog-btn" data-jog="e-">
                                     <i class="material-icons">arrow_downward</i>
                                 </button>
-                                <button class="btn waves-effect waves-light" onclick="sendCommand('e +')">
+                                <button class="btn waves-effect waves-light jog-btn" data-jog="e+">
                                     <i class="material-icons">arrow_upward</i>
                                 </button>
                             </div>
@@ -323,6 +335,20 @@ const char MAIN_UI[] PROGMEM = R"rawliteral(
                                         <span>Wave</span>
                                     </button>
                                 </div>
+                                <div class="collection-item button-group">
+                                    <button class="btn waves-effect waves-light movement-btn" onclick="sendCommand('a p')">
+                                        <i class="material-icons">pause</i>
+                                        <span>Pause</span>
+                                    </button>
+                                    <button class="btn waves-effect waves-light movement-btn" onclick="sendCommand('a r')">
+                                        <i class="material-icons">play_arrow</i>
+                                        <span>Resume</span>
+                                    </button>
+                                    <button class="btn waves-effect waves-light movement-btn" onclick="sendCommand('a x')">
+                                        <i class="material-icons">block</i>
+                                        <span>Abort</span>
+                                    </button>
+                                </div>
                             </div>
                         </div>
 
@@ -392,14 +418,145 @@ const char MAIN_UI[] PROGMEM = R"rawliteral(
         document.addEventListener('DOMContentLoaded', function() {
             var tabs = document.querySelectorAll('.tabs');
             M.Tabs.init(tabs);
+            initJogButtons();
+            initStick(document.getElementById('driveStick'), function(x, y) {
+                driveAxes = [-y * 100, -x * 100];
+            });
+            initStick(document.getElementById('armStick'), function(x, y) {
+                armAxes = [x * 100, -y * 100, 0, 0];
+            });
+            connectTeleop();
+            setInterval(sendTeleopFrame, TELEOP_INTERVAL);
         });
 
-        function sendCommand(cmd) {
-            fetch('/command?cmd=' + cmd)
+        // Teleop: sticks and gamepad stream axis frames over a WebSocket.
+        // The robot keeps only the newest frame, so nothing queues up behind
+        // a slow link. Frames carry a timestamp; late ones are dropped.
+        var TELEOP_INTERVAL = 40;  // ms, 25 Hz
+        var teleopSocket = null;
+        var driveAxes = [0, 0];        // linear, angular
+        var armAxes = [0, 0, 0, 0];    // base, shoulder, elbow, gripper
+        var idleFrames = 0;
+        var lastFrame = '';
+        var heartbeatTicks = 0;
+        var HEARTBEAT_EVERY = 4;      // ticks; well inside the robot's 500 ms lease
+
+        function connectTeleop() {
+            teleopSocket = new WebSocket('ws://' + location.hostname + ':81/');
+            teleopSocket.onclose = function() {
+                setTimeout(connectTeleop, 1000);
+            };
+        }
+
+        function readGamepad() {
+            var pads = navigator.getGamepads ? navigator.getGamepads() : [];
+            for (var i = 0; i < pads.length; i++) {
+                var pad = pads[i];
+                if (!pad || pad.axes.length < 4) continue;
+                var axis = function(n) {
+                    return Math.abs(pad.axes[n]) < 0.15 ? 0 : pad.axes[n] * 100;
+                };
+                var button = function(n) {
+                    return pad.buttons[n] && pad.buttons[n].pressed ? 100 : 0;
+                };
+                var axes = [-axis(1), -axis(0), axis(2), -axis(3),
+                            button(7) - button(6), button(5) - button(4)];
+                if (axes.some(function(v) { return v !== 0; })) return axes;
+            }
+            return null;
+        }
+
+        function sendTeleopFrame() {
+            var axes = readGamepad() || driveAxes.concat(armAxes);
+            // Stream while input is held, then a few zero frames for the release
+            if (axes.some(function(v) { return Math.round(v) !== 0; })) {
+                idleFrames = 3;
+            } else if (idleFrames > 0) {
+                idleFrames--;
+            } else {
+                return;
+            }
+            if (!teleopSocket || teleopSocket.readyState !== WebSocket.OPEN) return;
+            // An unchanged stick only needs to keep the drive lease alive. A
+            // held arm axis resends its frame instead: only a jog renews the
+            // joint's own timeout.
+            var frame = axes.map(Math.round).join(' ');
+            var armHeld = axes.slice(2).some(function(v) { return Math.round(v) !== 0; });
+            if (frame === lastFrame && idleFrames === 3) {
+                if (++heartbeatTicks < HEARTBEAT_EVERY) return;
+                heartbeatTicks = 0;
+                if (!armHeld) {
+                    teleopSocket.send('h');
+                    return;
+                }
+            }
+            lastFrame = frame;
+            heartbeatTicks = 0;
+            teleopSocket.send(Math.round(performance.now()) + ' ' + frame);
+        }
+
+        function initStick(stick, onMove) {
+            var knob = stick.querySelector('.stick-knob');
+            function move(e) {
+                var rect = stick.getBoundingClientRect();
+                var radius = rect.width / 2;
+                var x = (e.clientX - rect.left - radius) / radius;
+                var y = (e.clientY - rect.top - radius) / radius;
+                var length = Math.hypot(x, y);
+                if (length > 1) {
+                    x /= length;
+                    y /= length;
+                }
+                knob.style.left = (50 + x * 32) + '%';
+                knob.style.top = (50 + y * 32) + '%';
+                onMove(x, y);
+            }
+            function release() {
+                knob.style.left = '50%';
+                knob.style.top = '50%';
+                onMove(0, 0);
+            }
+            stick.addEventListener('pointerdown', function(e) {
+                e.preventDefault();
+                stick.setPointerCapture(e.pointerId);
+                move(e);
+            });
+            stick.addEventListener('pointermove', function(e) {
+                if (stick.hasPointerCapture(e.pointerId)) move(e);
+            });
+            stick.addEventListener('pointerup', release);
+            stick.addEventListener('pointercancel', release);
+            stick.addEventListener('lostpointercapture', release);
+        }
+
+        // Jog: press starts continuous joint motion, release stops it
+        function initJogButtons() {
+            document.querySelectorAll('[data-jog]').forEach(function(btn) {
+                var jog = btn.dataset.jog;
+                var held = false;
+                function release() {
+                    if (!held) return;
+                    held = false;
+                    sendCommand('j' + jog.charAt(0) + '0', true);
+                }
+                btn.addEventListener('pointerdown', function(e) {
+                    e.preventDefault();
+                    btn.setPointerCapture(e.pointerId);
+                    held = true;
+                    sendCommand('j' + jog, true);
+                });
+                btn.addEventListener('pointerup', release);
+                btn.addEventListener('pointercancel', release);
+                btn.addEventListener('lostpointercapture', release);
+            });
+        }
+
+        function sendCommand(cmd, quiet) {
+            fetch('/command?cmd=' + encodeURIComponent(cmd))
                 .then(response => response.text())
                 .then(data => {
                     console.log(data);
-                    M.toast({html: 'Command sent: ' + cmd, classes: 'rounded green'});
+                    if (!quiet) M.toast({html: 'Command sent: ' + cmd, classes: 'rounded green'});
                 })
                 .catch(error => {
                     console.error('Error:', error);
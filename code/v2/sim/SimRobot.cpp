@@ -0,0 +1,219 @@
+#include "SimRobot.h"
+#include "BoardConfig.h"
+
+// Small two-wheel chassis with TT gear motors and an HC-SR04
+SimRobot::Model SimRobot::defaultModel() {
+    Model m;
+    m.wheelBase = 14.0f;
+    m.radius = 9.0f;
+    m.maxSpeed = 40.0f;
+    m.stallDuty = 40;
+    m.motorLag = 0.08f;
+    m.mismatch = 0;
+    m.sag = 0;
+    m.tickLength = 0.54f;  // 20-slot disc on a 65mm wheel
+    m.beamWidth = 15.0f;
+    m.beamRays = 5;
+    m.noise = 1.0f;
+    m.dropout = 0.02f;
+    m.minRange = 2.0f;
+    return m;
+}
+
+SimRobot::SimRobot(const World &w, const Model &m, uint32_t seed)
+    : world(w), model(m), rng(seed), gauss(0.0f, 1.0f), uniform(0.0f, 1.0f) {
+    mounts.push_back({Board::Pins::ECHO_PIN, NO_TRIGGER, 8.0f, 0.0f});
+    encoderPins[0] = encoderPins[1] = NO_TRIGGER;
+    buildCells();
+    place(world.startX, world.startY, world.startHeading);
+}
+
+void SimRobot::place(float px, float py, float h) {
+    x = px;
+    y = py;
+    heading = h;
+    leftSpeed = rightSpeed = 0;
+    travelled = 0;
+    collisions = contactTime = 0;
+    echoes = dropouts = 0;
+    touching = world.collides(x, y, model.radius);
+    slack = 0;
+    tickPhase[0] = tickPhase[1] = 0;
+    for (uint8_t &cell : cells) {
+        if (cell == 2) cell = 1;
+    }
+    visitedCells = 0;
+    visit();
+}
+
+void SimRobot::addSensor(uint8_t echoPin, float forward, float angle, uint8_t trigPin) {
+    mounts.push_back({echoPin, trigPin, forward, angle});
+}
+
+void SimRobot::setEncoders(uint8_t leftPin, uint8_t rightPin) {
+    encoderPins[0] = leftPin;
+    encoderPins[1] = rightPin;
+}
+
+float SimRobot::rotationRate() const {
+    return 2.0f * model.maxSpeed / model.wheelBase * (float)RAD_TO_DEG;
+}
+
+// Signed wheel speed the bridge asks for, cm/s. Both inputs high brakes.
+// gain scales the motor's top speed, for mismatch and battery sag.
+float SimRobot::wheelCommand(uint8_t in1, uint8_t in2, uint8_t enable, float gain) const {
+    int direction = Sim::pinLevel(in1) - Sim::pinLevel(in2);
+    int duty = Sim::pinDuty(enable);
+    if (direction == 0 || duty <= model.stallDuty) return 0;
+    return direction * gain * model.maxSpeed * (duty - model.stallDuty) / (255.0f - model.stallDuty);
+}
+
+void SimRobot::step(uint32_t us) {
+    typedef Board::Pins P;
+    float dt = us / 1e6f;
+    float blend = dt / (model.motorLag + dt);
+    float battery = max(0.0f, 1.0f - model.sag * Sim::now() / 60e6f);
+    float leftGain = battery * (1.0f + model.mismatch / 2), rightGain = battery * (1.0f - model.mismatch / 2);
+    leftSpeed += blend * (wheelCommand(P::MOTOR1_IN1, P::MOTOR1_IN2, P::MOTOR1_ENA, leftGain) - leftSpeed);
+    rightSpeed += blend * (wheelCommand(P::MOTOR2_IN1, P::MOTOR2_IN2, P::MOTOR2_ENB, rightGain) - rightSpeed);
+    tick(0, leftSpeed, us);
+    tick(1, rightSpeed, us);
+
+    float linear = (leftSpeed + rightSpeed) / 2.0f;
+    heading += (rightSpeed - leftSpeed) / model.wheelBase * dt;
+    float moved = fabsf(linear) * dt;
+    if (moved < 1e-6f) return;
+    float nx = x + linear * cosf(heading) * dt;
+    float ny = y + linear * sinf(heading) * dt;
+
+    // Walls are only checked once the robot may have used up the clearance
+    // it had at the last check. A wall stops translation but the wheels may
+    // still turn the body.
+    slack -= moved;
+    if (slack < 0) {
+        float gap = world.clearance(nx, ny) - model.radius;
+        if (gap < 0) {
+            if (!touching) collisions++;
+            touching = true;
+            contactTime += us / 1000;
+            slack = 0;
+            return;
+        }
+        slack = gap;
+    }
+    touching = false;
+    travelled += moved;
+    x = nx;
+    y = ny;
+    visit();
+}
+
+// Schedules the ticks the wheel will reach over the next slice at the
+// speed it has now, so each edge lands at its own microsecond. Pressed
+// against a wall the wheels still turn, and still tick.
+void SimRobot::tick(uint8_t wheel, float speed, uint32_t us) {
+    if (encoderPins[wheel] == NO_TRIGGER || model.tickLength <= 0) return;
+    float ticks = fabsf(speed) * us / 1e6f / model.tickLength;
+    if (ticks <= 0) return;
+    float &phase = tickPhase[wheel];
+    uint64_t start = Sim::now();
+    for (float edge = 1.0f - phase; edge <= ticks; edge += 1.0f) {
+        uint64_t at = start + (uint64_t)(edge / ticks * us);
+        Sim::schedule(encoderPins[wheel], HIGH, at);
+        Sim::schedule(encoderPins[wheel], LOW, at + ENCODER_PULSE);
+    }
+    phase = fmodf(phase + ticks, 1.0f);
+}
+
+// Beyond the timeout the firmware sees no pulse at all, as with a real HC-SR04
+unsigned long SimRobot::echo(uint8_t pin, unsigned long timeout) {
+    for (const Mount &m : mounts) {
+        if (m.echoPin != pin) continue;
+        unsigned long duration = measure(m);
+        return duration < timeout ? duration : 0;
+    }
+    return 0;
+}
+
+// A trigger pulse ends on its falling edge; the echo pin then rises and
+// stays high for the round trip, or NO_RETURN when nothing comes back
+void SimRobot::pinChanged(uint8_t pin, uint8_t level) {
+    if (level) return;
+    for (const Mount &m : mounts) {
+        if (m.trigPin != pin) continue;
+        unsigned long duration = measure(m);
+        uint64_t rise = Sim::now() + ECHO_DELAY;
+        Sim::schedule(m.echoPin, HIGH, rise);
+        Sim::schedule(m.echoPin, LOW, rise + (duration ? duration : NO_RETURN));
+    }
+}
+
+// Nearest return across the cone plus noise, as an echo pulse in us, 0 = none
+unsigned long SimRobot::measure(const Mount &mount) {
+    echoes++;
+    if (uniform(rng) < model.dropout) {
+        dropouts++;
+        return 0;
+    }
+
+    float sx = x + mount.forward * cosf(heading);
+    float sy = y + mount.forward * sinf(heading);
+    float centre = heading + mount.angle * (float)DEG_TO_RAD;
+    float width = model.beamWidth * (float)DEG_TO_RAD;
+    float nearest = 1e9f;
+    for (uint8_t i = 0; i < model.beamRays; i++) {
+        float offset = model.beamRays > 1 ? width * ((float)i / (model.beamRays - 1) - 0.5f) : 0;
+        nearest = min(nearest, world.raycast(sx, sy, centre + offset, 1000.0f));
+    }
+
+    float distance = nearest + model.noise * gauss(rng);
+    if (distance < model.minRange) return 0;
+    return (unsigned long)(distance / 0.017f);  // firmware: us * 0.034 / 2
+}
+
+// Floor cells are those reachable from the start without crossing a wall
+void SimRobot::buildCells() {
+    columns = (int)ceilf((world.maxX - world.minX) / CELL);
+    rows = (int)ceilf((world.maxY - world.minY) / CELL);
+    cells.assign(columns * rows, 0);
+    floorCells = 0;
+
+    int startColumn = (int)((world.startX - world.minX) / CELL);
+    int startRow = (int)((world.startY - world.minY) / CELL);
+    if (startColumn < 0 || startColumn >= columns || startRow < 0 || startRow >= rows) return;
+
+    std::vector<int> stack(1, startRow * columns + startColumn);
+    cells[stack[0]] = 1;
+    const int dc[4] = {1, -1, 0, 0}, dr[4] = {0, 0, 1, -1};
+    while (!stack.empty()) {
+        int index = stack.back();
+        stack.pop_back();
+        floorCells++;
+        int c = index % columns, r = index / columns;
+        float cx = world.minX + (c + 0.5f) * CELL, cy = world.minY + (r + 0.5f) * CELL;
+        for (int k = 0; k < 4; k++) {
+            int nc = c + dc[k], nr = r + dr[k];
+            if (nc < 0 || nc >= columns || nr < 0 || nr >= rows) continue;
+            int next = nr * columns + nc;
+            if (cells[next] != 0) continue;
+            if (world.raycast(cx, cy, atan2f((float)dr[k], (float)dc[k]), CELL) < CELL) continue;
+            if (world.collides(cx + dc[k] * CELL, cy + dr[k] * CELL, model.radius)) continue;
+            cells[next] = 1;
+            stack.push_back(next);
+        }
+    }
+}
+
+void SimRobot::visit() {
+    int c = (int)((x - world.minX) / CELL), r = (int)((y - world.minY) / CELL);
+    if (c < 0 || c >= columns || r < 0 || r >= rows) return;
+    uint8_t &cell = cells[r * columns + c];
+    if (cell == 1) {
+        cell = 2;
+        visitedCells++;
+    }
+}
+
+float SimRobot::coverage() const {
+    return floorCells ? (float)visitedCells / floorCells : 0;
+}
@@ -0,0 +1,97 @@
+#ifndef SIM_ROBOT_H
+#define SIM_ROBOT_H
+
+#include <Arduino.h>
+#include <random>
+#include <vector>
+#include "World.h"
+
+// Differential-drive robot driven by the firmware's own pin writes. The
+// H-bridge direction pins and enable duties set each wheel's command; the
+// ultrasonic sensors answer pulseIn() with an echo raycast into the world,
+// or, when they have a trigger pin, drive their echo pin after each trigger.
+// Optional wheel encoders pulse their pins as the wheels turn.
+class SimRobot : public Sim::Hardware {
+  public:
+    struct Model {
+      float wheelBase;      // cm between the wheels
+      float radius;         // cm, body treated as a circle
+      float maxSpeed;       // cm/s per wheel at full duty
+      int stallDuty;        // duty (of 255) below which a wheel does not turn
+      float motorLag;       // s, first-order time constant of a wheel
+      float mismatch;       // 0..1, the right motor is this much weaker than the left
+      float sag;            // 0..1, top speed lost per minute as the battery drains
+      float tickLength;     // cm of wheel travel per encoder tick
+      float beamWidth;      // degrees, full cone of the sensor
+      uint8_t beamRays;     // rays cast across the cone, nearest wins
+      float noise;          // cm, standard deviation of each reading
+      float dropout;        // 0..1, chance that an echo is lost
+      float minRange;       // cm, closer than this reads as nothing
+    };
+
+    // One ultrasonic sensor: where it sits and which pins it uses
+    struct Mount {
+      uint8_t echoPin;
+      uint8_t trigPin;      // NO_TRIGGER: answers pulseIn() only
+      float forward;        // cm ahead of the wheel axis
+      float angle;          // degrees from straight ahead, CCW positive
+    };
+
+    static const uint8_t NO_TRIGGER = 255;
+    static constexpr uint32_t ECHO_DELAY = 450;   // us from trigger to echo rising
+    static constexpr uint32_t NO_RETURN = 38000;  // us the echo stays high with nothing back
+    static constexpr uint32_t ENCODER_PULSE = 50; // us an encoder pin stays high per tick
+
+    static Model defaultModel();
+
+    SimRobot(const World &world, const Model &model, uint32_t seed);
+
+    void place(float x, float y, float heading);
+    void addSensor(uint8_t echoPin, float forward, float angle, uint8_t trigPin = NO_TRIGGER);
+    void clearSensors() { mounts.clear(); }
+    // Rising edge per tick on each pin; NO_TRIGGER leaves the encoders off
+    void setEncoders(uint8_t leftPin, uint8_t rightPin);
+
+    void step(uint32_t micros) override;
+    unsigned long echo(uint8_t pin, unsigned long timeout) override;
+    void pinChanged(uint8_t pin, uint8_t level) override;
+
+    // Ground truth
+    float x, y, heading;            // cm, cm, radians CCW from +x
+    float leftSpeed, rightSpeed;    // cm/s
+    float travelled;                // cm
+    uint32_t collisions;            // separate contacts with a wall
+    uint32_t contactTime;           // ms spent pressed against a wall
+    uint32_t echoes, dropouts;
+
+    // Turn rate at full duty, for calibrating the firmware's dead reckoning
+    float rotationRate() const;
+    // Fraction of the reachable floor driven over, in CELL sized squares
+    float coverage() const;
+
+    static constexpr float CELL = 25.0f;
+
+  private:
+    const World &world;
+    Model model;
+    std::vector<Mount> mounts;
+    std::mt19937 rng;
+    std::normal_distribution<float> gauss;
+    std::uniform_real_distribution<float> uniform;
+    bool touching;
+    float slack;                    // cm the robot can move before walls are checked again
+    uint8_t encoderPins[2];
+    float tickPhase[2];             // ticks of travel since the last edge, 0..1
+
+    int columns, rows;
+    std::vector<uint8_t> cells;     // 0 = wall, 1 = floor, 2 = visited
+    uint32_t floorCells, visitedCells;
+
+    unsigned long measure(const Mount &mount);
+    float wheelCommand(uint8_t in1, uint8_t in2, uint8_t enable, float gain) const;
+    void tick(uint8_t wheel, float speed, uint32_t us);
+    void buildCells();
+    void visit();
+};
+
+#endif
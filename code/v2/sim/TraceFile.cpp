@@ -0,0 +1,49 @@
+#include "TraceFile.h"
+
+#include <stdio.h>
+
+void TraceTap::onSample(void *context, int8_t, DistanceEvent, const DistanceSample &sample) {
+    TraceTap *tap = static_cast<TraceTap *>(context);
+    if (!tap->trace->isRecording()) return;
+    if ((tap->trace->getHeader().flags & TRACE_NAVIGATING) && !tap->oa->navigating()) {
+        tap->trace->stop();
+        return;
+    }
+    tap->trace->record(sample.time, sample.echo, tap->motors->getDuty(BoardMotors::WHEEL_LEFT),
+                       tap->motors->getDuty(BoardMotors::WHEEL_RIGHT));
+}
+
+// Same layout as GET /trace on the robot
+bool writeTrace(const char *path, const SensorTrace &trace, std::string &error) {
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        error = std::string("cannot write ") + path;
+        return false;
+    }
+    bool ok = fwrite(&trace.getHeader(), sizeof(TraceHeader), 1, file) == 1 &&
+              fwrite(trace.getEntries(), sizeof(TraceEntry), trace.size(), file) == trace.size();
+    ok = fclose(file) == 0 && ok;
+    if (!ok) error = std::string("cannot write ") + path;
+    return ok;
+}
+
+bool readTrace(const char *path, TraceHeader &header, std::vector<TraceEntry> &entries, std::string &error) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        error = std::string("cannot open ") + path;
+        return false;
+    }
+    entries.clear();
+    bool ok = fread(&header, sizeof(header), 1, file) == 1 && memcmp(header.magic, "OATR", 4) == 0;
+    if (!ok) {
+        error = std::string(path) + ": not a trace";
+    } else if (header.version != TRACE_VERSION) {
+        error = std::string(path) + ": unsupported trace version " + std::to_string(header.version);
+        ok = false;
+    } else {
+        TraceEntry entry;
+        while (fread(&entry, sizeof(entry), 1, file) == 1) entries.push_back(entry);
+    }
+    fclose(file);
+    return ok;
+}
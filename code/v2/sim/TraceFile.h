@@ -0,0 +1,22 @@
+#ifndef SIM_TRACE_FILE_H
+#define SIM_TRACE_FILE_H
+
+#include <string>
+#include <vector>
+#include "ObstacleAvoidance.h"
+#include "SensorTrace.h"
+
+// Records into a SensorTrace the way code.ino does: each sample's echo next
+// to the wheel duties, ending when navigation stops
+struct TraceTap {
+    SensorTrace *trace;
+    BoardMotors *motors;
+    ObstacleAvoidance *oa;
+
+    static void onSample(void *context, int8_t id, DistanceEvent event, const DistanceSample &sample);
+};
+
+bool writeTrace(const char *path, const SensorTrace &trace, std::string &error);
+bool readTrace(const char *path, TraceHeader &header, std::vector<TraceEntry> &entries, std::string &error);
+
+#endif
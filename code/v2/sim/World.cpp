@@ -0,0 +1,103 @@
+#include "World.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+bool World::load(const char *path, std::string &error) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        error = std::string("cannot open ") + path;
+        return false;
+    }
+
+    const char *slash = strrchr(path, '/');
+    name = slash ? slash + 1 : path;
+    segments.clear();
+    waypoints.clear();
+    startX = startY = startHeading = 0;
+    bool haveStart = false;
+
+    char line[256];
+    int number = 0;
+    while (fgets(line, sizeof(line), file)) {
+        number++;
+        char keyword[16];
+        float a, b, c, d;
+        if (sscanf(line, "%15s", keyword) != 1 || keyword[0] == '#') continue;
+
+        if (strcmp(keyword, "wall") == 0 && sscanf(line, "%*s %f %f %f %f", &a, &b, &c, &d) == 4) {
+            add(a, b, c, d);
+        } else if (strcmp(keyword, "box") == 0 && sscanf(line, "%*s %f %f %f %f", &a, &b, &c, &d) == 4) {
+            add(a, b, a + c, b);
+            add(a + c, b, a + c, b + d);
+            add(a + c, b + d, a, b + d);
+            add(a, b + d, a, b);
+        } else if (strcmp(keyword, "start") == 0 && sscanf(line, "%*s %f %f %f", &a, &b, &c) == 3) {
+            startX = a;
+            startY = b;
+            startHeading = c * (float)M_PI / 180.0f;
+            haveStart = true;
+        } else if (strcmp(keyword, "waypoint") == 0 && sscanf(line, "%*s %f %f", &a, &b) == 2) {
+            waypoints.push_back({a, b});
+        } else {
+            char buffer[64];
+            snprintf(buffer, sizeof(buffer), ":%d: cannot parse", number);
+            error = path + std::string(buffer);
+            fclose(file);
+            return false;
+        }
+    }
+    fclose(file);
+
+    if (segments.empty() || !haveStart) {
+        error = std::string(path) + ": needs walls and a start line";
+        return false;
+    }
+    minX = minY = 1e9f;
+    maxX = maxY = -1e9f;
+    for (const Segment &s : segments) {
+        minX = std::min(minX, std::min(s.x1, s.x2));
+        minY = std::min(minY, std::min(s.y1, s.y2));
+        maxX = std::max(maxX, std::max(s.x1, s.x2));
+        maxY = std::max(maxY, std::max(s.y1, s.y2));
+    }
+    return true;
+}
+
+void World::add(float x1, float y1, float x2, float y2) {
+    segments.push_back({x1, y1, x2, y2});
+}
+
+float World::raycast(float x, float y, float angle, float maxRange) const {
+    float dx = cosf(angle), dy = sinf(angle);
+    float best = maxRange;
+    for (const Segment &s : segments) {
+        float ex = s.x2 - s.x1, ey = s.y2 - s.y1;
+        float denominator = dx * ey - dy * ex;
+        if (fabsf(denominator) < 1e-9f) continue;  // parallel
+        float wx = s.x1 - x, wy = s.y1 - y;
+        float t = (wx * ey - wy * ex) / denominator;  // along the ray
+        float u = (wx * dy - wy * dx) / denominator;  // along the segment
+        if (t >= 0 && u >= 0 && u <= 1 && t < best) best = t;
+    }
+    return best;
+}
+
+float World::clearance(float x, float y) const {
+    float best = 1e18f;
+    for (const Segment &s : segments) {
+        float ex = s.x2 - s.x1, ey = s.y2 - s.y1;
+        float length = ex * ex + ey * ey;
+        float u = length > 0 ? ((x - s.x1) * ex + (y - s.y1) * ey) / length : 0;
+        u = std::max(0.0f, std::min(1.0f, u));
+        float cx = s.x1 + u * ex - x, cy = s.y1 + u * ey - y;
+        best = std::min(best, cx * cx + cy * cy);
+    }
+    return sqrtf(best);
+}
+
+bool World::inside(float x, float y) const {
+    return x > minX && x < maxX && y > minY && y < maxY;
+}
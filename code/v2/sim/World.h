@@ -0,0 +1,48 @@
+#ifndef SIM_WORLD_H
+#define SIM_WORLD_H
+
+#include <string>
+#include <vector>
+
+// Static 2D world made of wall segments, in cm. Loaded from a text file:
+//
+//   # comment
+//   wall  x1 y1 x2 y2      one wall segment
+//   box   x y w h          four walls around a rectangle
+//   start x y heading      start pose, heading in degrees (0 = +x, CCW)
+//   waypoint x y           route point for --mode route, in order
+//
+// Anything inside the bounding box of the walls counts as floor.
+class World {
+  public:
+    struct Segment {
+      float x1, y1, x2, y2;
+    };
+
+    struct Point {
+      float x, y;
+    };
+
+    bool load(const char *path, std::string &error);
+
+    // Distance along a ray to the nearest wall, or maxRange
+    float raycast(float x, float y, float angle, float maxRange) const;
+    // Distance from (x, y) to the nearest wall
+    float clearance(float x, float y) const;
+    // True if a circle of radius r at (x, y) touches a wall
+    bool collides(float x, float y, float radius) const { return clearance(x, y) < radius; }
+    bool inside(float x, float y) const;
+
+    const std::string &getName() const { return name; }
+    float startX, startY, startHeading;  // heading in radians
+    float minX, minY, maxX, maxY;
+    std::vector<Point> waypoints;
+
+  private:
+    std::string name;
+    std::vector<Segment> segments;
+
+    void add(float x1, float y1, float x2, float y2);
+};
+
+#endif
@@ -0,0 +1,193 @@
+#include "Arduino.h"
+#include <stdarg.h>
+#include <queue>
+#include <vector>
+
+SimSerial Serial;
+SimEsp ESP;
+
+namespace Sim {
+
+static const uint8_t PIN_COUNT = 64;
+static const uint32_t STEP = 1000;  // hardware is stepped in 1ms slices
+
+static Hardware *hardware = NULL;
+static uint64_t clock = 0;
+static uint32_t pending = 0;        // advanced but not yet stepped
+static uint8_t levels[PIN_COUNT];
+static int duties[PIN_COUNT];
+bool verbose = false;
+
+struct Edge {
+    uint64_t at;
+    uint8_t pin;
+    uint8_t level;
+    uint32_t order;  // keeps edges at the same time in schedule order
+    bool operator>(const Edge &other) const {
+        return at != other.at ? at > other.at : order > other.order;
+    }
+};
+
+struct Interrupt {
+    void (*handler)(void *);
+    void *arg;
+    int mode;
+};
+
+static std::priority_queue<Edge, std::vector<Edge>, std::greater<Edge> > edges;
+static uint32_t edgeCount = 0;
+static Interrupt handlers[PIN_COUNT];
+
+void attach(Hardware *h) {
+    hardware = h;
+}
+
+void reset() {
+    clock = 0;
+    pending = 0;
+    memset(levels, 0, sizeof(levels));
+    memset(duties, 0, sizeof(duties));
+    memset(handlers, 0, sizeof(handlers));
+    edges = std::priority_queue<Edge, std::vector<Edge>, std::greater<Edge> >();
+}
+
+void schedule(uint8_t pin, uint8_t level, uint64_t at) {
+    if (pin < PIN_COUNT) edges.push({std::max(at, clock), pin, level, edgeCount++});
+}
+
+static void fire(const Edge &edge) {
+    uint8_t old = levels[edge.pin];
+    levels[edge.pin] = edge.level;
+    const Interrupt &i = handlers[edge.pin];
+    if (!i.handler || old == edge.level) return;
+    if (i.mode == CHANGE || (i.mode == RISING && edge.level) || (i.mode == FALLING && !edge.level)) {
+        i.handler(i.arg);
+    }
+}
+
+// Steps the hardware every STEP and delivers scheduled edges in between,
+// so an interrupt handler reads micros() at the edge itself
+void advance(uint32_t us) {
+    uint64_t target = clock + us;
+    for (;;) {
+        uint64_t step = clock + (STEP - pending);
+        uint64_t edge = edges.empty() ? UINT64_MAX : edges.top().at;
+        uint64_t next = std::min(std::min(step, edge), target);
+        pending += (uint32_t)(next - clock);
+        clock = next;
+        if (edge <= next) {
+            Edge e = edges.top();
+            edges.pop();
+            fire(e);
+        } else if (next == step) {
+            pending = 0;
+            if (hardware) hardware->step(STEP);
+        } else {
+            return;
+        }
+    }
+}
+
+uint64_t now() {
+    return clock;
+}
+
+int pinLevel(uint8_t pin) {
+    return pin < PIN_COUNT ? levels[pin] : 0;
+}
+
+int pinDuty(uint8_t pin) {
+    return pin < PIN_COUNT ? duties[pin] : 0;
+}
+
+} // namespace Sim
+
+void pinMode(uint8_t, uint8_t) {
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+    if (pin >= Sim::PIN_COUNT) return;
+    uint8_t level = value ? HIGH : LOW;
+    if (Sim::levels[pin] == level) return;
+    Sim::levels[pin] = level;
+    if (Sim::hardware) Sim::hardware->pinChanged(pin, level);
+}
+
+int digitalRead(uint8_t pin) {
+    return Sim::pinLevel(pin);
+}
+
+void analogWrite(uint8_t pin, int value) {
+    if (pin < Sim::PIN_COUNT) Sim::duties[pin] = value;
+}
+
+void Sim::servoWrite(uint8_t pin, int angle) {
+    if (pin < Sim::PIN_COUNT) Sim::duties[pin] = angle;
+}
+
+bool ledcAttach(uint8_t pin, uint32_t, uint8_t) {
+    return pin < Sim::PIN_COUNT;
+}
+
+bool ledcWrite(uint8_t pin, uint32_t duty) {
+    if (pin >= Sim::PIN_COUNT) return false;
+    Sim::duties[pin] = (int)duty;
+    return true;
+}
+
+unsigned long millis() {
+    return (unsigned long)(Sim::clock / 1000);
+}
+
+unsigned long micros() {
+    return (unsigned long)Sim::clock;
+}
+
+void delay(unsigned long ms) {
+    Sim::advance(ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us) {
+    Sim::advance(us);
+}
+
+// Blocks for the echo like the real call, so sensor reads cost sim time
+unsigned long pulseIn(uint8_t pin, uint8_t, unsigned long timeout) {
+    unsigned long duration = Sim::hardware ? Sim::hardware->echo(pin, timeout) : 0;
+    Sim::advance(duration > 0 ? duration : timeout);
+    return duration;
+}
+
+void attachInterruptArg(uint8_t pin, void (*handler)(void *), void *arg, int mode) {
+    if (pin < Sim::PIN_COUNT) Sim::handlers[pin] = {handler, arg, mode};
+}
+
+void detachInterrupt(uint8_t pin) {
+    if (pin < Sim::PIN_COUNT) Sim::handlers[pin] = {NULL, NULL, 0};
+}
+
+// Busy-wait loops in the firmware call this; each call is one step
+void yield() {
+    Sim::advance(Sim::STEP);
+}
+
+void SimSerial::print(const char *text) {
+    if (Sim::verbose) fputs(text, stdout);
+}
+
+void SimSerial::println(const char *text) {
+    if (Sim::verbose) puts(text);
+}
+
+void SimSerial::printf(const char *format, ...) {
+    if (!Sim::verbose) return;
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+}
+
+// 240MHz worth of cycles per virtual microsecond
+uint32_t SimEsp::getCycleCount() {
+    return (uint32_t)(Sim::clock * 240);
+}
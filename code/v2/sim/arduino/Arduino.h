@@ -0,0 +1,118 @@
+#ifndef SIM_ARDUINO_H
+#define SIM_ARDUINO_H
+
+// Host stand-in for the Arduino core, just enough for the motor, sensor,
+// obstacle-avoidance and arm drivers. Time is virtual: it only moves when the
+// firmware waits (delay, pulseIn, yield) or the simulator advances it, so a
+// minute of driving runs in a few milliseconds.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include <algorithm>
+#include <string>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define RISING 1
+#define FALLING 2
+#define CHANGE 3
+#define NOT_AN_INTERRUPT -1
+#define digitalPinToInterrupt(p) ((int)(p))
+#define IRAM_ATTR
+#define PROGMEM
+#define DEG_TO_RAD 0.017453292519943295769236907684886
+#define RAD_TO_DEG 57.295779513082320876798154814105
+#define ARDUINO_HOST 1                // this shim, not a real core
+#define ESP_ARDUINO_VERSION_MAJOR 3   // LEDC calls take the pin, as in core 3
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+using std::min;
+using std::max;
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+void analogWrite(uint8_t pin, int value);
+bool ledcAttach(uint8_t pin, uint32_t frequency, uint8_t resolution);
+bool ledcWrite(uint8_t pin, uint32_t duty);
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+unsigned long pulseIn(uint8_t pin, uint8_t state, unsigned long timeout = 1000000UL);
+void yield();
+void attachInterruptArg(uint8_t pin, void (*handler)(void *), void *arg, int mode);
+void detachInterrupt(uint8_t pin);
+
+// The parts of Arduino's String the drivers use for log lines
+class String {
+  public:
+    String(const char *text = "") : text(text) {}
+    String(const std::string &text) : text(text) {}
+    String(int value) : text(std::to_string(value)) {}
+    String(unsigned long value) : text(std::to_string(value)) {}
+    const char *c_str() const { return text.c_str(); }
+    unsigned int length() const { return text.size(); }
+    friend String operator+(const String &a, const String &b) { return a.text + b.text; }
+    friend String operator+(const char *a, const String &b) { return a + b.text; }
+    friend String operator+(const String &a, const char *b) { return a.text + b; }
+
+  private:
+    std::string text;
+};
+
+struct SimSerial {
+    void begin(unsigned long) {}
+    void print(const char *text);
+    void print(const String &text) { print(text.c_str()); }
+    void print(int value) { print(String(value)); }
+    void println(const char *text = "");
+    void println(const String &text) { println(text.c_str()); }
+    void println(int value) { println(String(value)); }
+    void printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+};
+extern SimSerial Serial;
+
+struct SimEsp {
+    uint32_t getCycleCount();
+    void restart() {}
+};
+extern SimEsp ESP;
+
+namespace Sim {
+
+// The simulated robot: moves with the pins, answers echo requests
+class Hardware {
+  public:
+    virtual ~Hardware() {}
+    virtual void step(uint32_t micros) = 0;
+    // Echo pulse length in us for a trigger on pin, 0 when none returns
+    virtual unsigned long echo(uint8_t pin, unsigned long timeout) = 0;
+    // The firmware changed an output
+    virtual void pinChanged(uint8_t pin, uint8_t level) { (void)pin; (void)level; }
+};
+
+void attach(Hardware *hardware);
+void reset();                    // clock to 0, pins low
+void advance(uint32_t micros);   // moves the clock and the hardware
+uint64_t now();                  // virtual time, us
+int pinLevel(uint8_t pin);
+int pinDuty(uint8_t pin);        // last analogWrite, ledcWrite or servo angle
+void servoWrite(uint8_t pin, int angle);
+// Drives an input to level at an absolute time, running its interrupt
+// handler with the clock at that exact microsecond
+void schedule(uint8_t pin, uint8_t level, uint64_t at);
+extern bool verbose;             // let Serial through to stdout
+
+} // namespace Sim
+
+#endif
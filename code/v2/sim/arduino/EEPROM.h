@@ -0,0 +1,27 @@
+#ifndef SIM_EEPROM_H
+#define SIM_EEPROM_H
+
+// Host stand-in for the EEPROM library: a zeroed byte array per run
+
+#include "Arduino.h"
+
+class SimEeprom {
+  public:
+    void begin(size_t) {}
+    bool commit() { return true; }
+    template <class T> T &get(int address, T &value) {
+        memcpy(&value, bytes + address, sizeof(T));
+        return value;
+    }
+    template <class T> const T &put(int address, const T &value) {
+        memcpy(bytes + address, &value, sizeof(T));
+        return value;
+    }
+
+  private:
+    uint8_t bytes[4096] = {};
+};
+
+inline SimEeprom EEPROM;
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef SIM_SERVO_H
+#define SIM_SERVO_H
+
+// Host stand-in for the Servo library. The written angle shows up as the
+// pin's duty, so tests read it with Sim::pinDuty.
+
+#include "Arduino.h"
+
+class Servo {
+  public:
+    uint8_t attach(int pin) {
+        this->pin = pin;
+        return 0;
+    }
+    void write(int value) {
+        angle = value;
+        Sim::servoWrite(pin, angle);
+    }
+    int read() { return angle; }
+
+  private:
+    int pin = -1;
+    int angle = 90;
+};
+
+#endif
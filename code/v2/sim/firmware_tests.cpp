@@ -0,0 +1,414 @@
+// Host tests for firmware pieces the batch runner does not exercise on its
+// own, against the Arduino shim in virtual time or on real threads. Build and
+// usage are in the top-level Readme, under Host Simulator.
+
+#include <Arduino.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include "CommandQueue.h"
+#include "CommandRing.h"
+#include "CommandSchedule.h"
+#include "DriveLease.h"
+#include "MotorController.h"
+#include "RobotArm.h"
+#include "Seqlock.h"
+#include "UltrasonicSensor.h"
+
+static int failures = 0;
+
+#define CHECK(condition) check((condition), #condition, __FILE__, __LINE__)
+
+static void check(bool ok, const char *what, const char *file, int line) {
+    if (ok) return;
+    printf("  %s:%d: %s\n", file, line, what);
+    failures++;
+}
+
+typedef MotorController<Board::Pins, AnalogPwm> Motors8;
+typedef MotorController<Board::Pins, LedcPwm<25000, 10>> Motors10;
+
+// Runs the ramp until both wheels reach their targets, returns the ms taken
+template <class Motors>
+static unsigned long settle(Motors &motors) {
+    unsigned long start = millis();
+    do {
+        Sim::advance(1000);
+        motors.update();
+    } while (!motors.isSettled() && millis() - start < 2000);
+    return millis() - start;
+}
+
+// The same 8-bit settings at either resolution: duties scale by
+// MAX_DUTY / 255 and the ramps take the same time
+template <class Motors>
+static void checkDutyMapping(int speed, int floor, unsigned long &rampTime) {
+    Sim::reset();
+    Motors motors;
+    motors.begin();
+    CHECK(motors.getSpeed() == speed);
+
+    motors.moveForward();
+    rampTime = settle(motors);
+    CHECK(Sim::pinDuty(Board::Pins::MOTOR1_ENA) == speed);
+    CHECK(Sim::pinDuty(Board::Pins::MOTOR2_ENB) == speed);
+    CHECK(motors.getDuty(Motors::WHEEL_LEFT) == speed);
+
+    // The smallest input starts from the deadband floor
+    motors.setVelocity(0.03f, 0);
+    settle(motors);
+    int slow = Sim::pinDuty(Board::Pins::MOTOR1_ENA);
+    CHECK(slow >= floor && slow <= floor + (speed - floor) / 20);
+
+    motors.setSpeed(Motors::MAX_DUTY + 1);
+    CHECK(motors.getSpeed() == Motors::MAX_DUTY);
+    motors.moveBackward();
+    settle(motors);
+    CHECK(Sim::pinDuty(Board::Pins::MOTOR1_ENA) == Motors::MAX_DUTY);
+    CHECK(motors.getDuty(Motors::WHEEL_RIGHT) == -Motors::MAX_DUTY);
+
+    motors.halt();
+    CHECK(Sim::pinDuty(Board::Pins::MOTOR1_ENA) == 0);
+}
+
+static void testDutyMapping() {
+    CHECK(Motors8::MAX_DUTY == 255);
+    CHECK(Motors10::MAX_DUTY == 1023);
+    unsigned long ramp8, ramp10;
+    checkDutyMapping<Motors8>(200, 50, ramp8);
+    checkDutyMapping<Motors10>(200 * 1023 / 255, 50 * 1023 / 255, ramp10);
+    CHECK(ramp8 >= 300 && ramp8 <= 360);  // 0 -> 200/255 in ~330ms
+    CHECK(ramp10 + 20 >= ramp8 && ramp10 <= ramp8 + 20);
+}
+
+// Runs the arm for ms in 1 ms steps; returns the times, relative to the
+// start, at which the base servo was written a new angle
+static std::vector<unsigned long> runArm(BoardArm &arm, unsigned long ms) {
+    std::vector<unsigned long> writes;
+    unsigned long start = millis();
+    int angle = Sim::pinDuty(Board::Pins::BASE_PIN);
+    while (millis() - start < ms) {
+        Sim::advance(1000);
+        arm.update();
+        if (Sim::pinDuty(Board::Pins::BASE_PIN) != angle) {
+            angle = Sim::pinDuty(Board::Pins::BASE_PIN);
+            writes.push_back(millis() - start);
+        }
+    }
+    return writes;
+}
+
+// a x freezes the joint at once; a e runs it out over 3 degrees, slower
+// each time, and is idle within 70 ms
+static void testArmAbort() {
+    Sim::reset();
+    BoardArm arm;
+    arm.begin();
+    runArm(arm, 100);  // home: already there
+
+    arm.moveJoint('b', '+');  // 90 -> 105
+    CHECK(runArm(arm, 45).size() == 5);  // first degree on the next tick
+    int angle = Sim::pinDuty(Board::Pins::BASE_PIN);
+    CHECK(angle == 95);
+    arm.abort();
+    CHECK(arm.getJobState() == BoardArm::JOB_IDLE);
+    CHECK(runArm(arm, 100).empty());
+    CHECK(Sim::pinDuty(Board::Pins::BASE_PIN) == angle);
+
+    arm.moveJoint('b', '+');  // 95 -> 110
+    runArm(arm, 55);
+    angle = Sim::pinDuty(Board::Pins::BASE_PIN);
+    arm.abort(true);
+    std::vector<unsigned long> writes = runArm(arm, 200);
+    CHECK(writes.size() == 3);
+    CHECK(Sim::pinDuty(Board::Pins::BASE_PIN) == angle + 3);
+    if (writes.size() == 3) {
+        CHECK(writes[0] <= 10);
+        CHECK(writes[1] - writes[0] > 10 && writes[2] - writes[1] > writes[1] - writes[0]);
+        CHECK(writes[2] <= 70);
+    }
+    CHECK(arm.getJobState() == BoardArm::JOB_IDLE);
+
+    // Close to the target it only runs out what is left
+    int target = Sim::pinDuty(Board::Pins::BASE_PIN) - 15;
+    arm.moveJoint('b', '-');
+    while (Sim::pinDuty(Board::Pins::BASE_PIN) > target + 2) runArm(arm, 1);
+    arm.abort(true);
+    CHECK(runArm(arm, 200).size() == 2);
+    CHECK(Sim::pinDuty(Board::Pins::BASE_PIN) == target);
+}
+
+// A wall at a fixed distance for the ultrasonic sensor
+struct Wall : Sim::Hardware {
+    float distance;
+    void step(uint32_t) override {}
+    unsigned long echo(uint8_t, unsigned long) override { return (unsigned long)(distance * 2 / 0.034f); }
+};
+
+static void onCrossing(void *context, int8_t, DistanceEvent event, const DistanceSample &) {
+    static_cast<std::vector<DistanceEvent> *>(context)->push_back(event);
+}
+
+// Moving the threshold across the current distance fires at once, without
+// waiting for the next reading
+static void testThresholdMove() {
+    Sim::reset();
+    Wall wall;
+    wall.distance = 50;
+    Sim::attach(&wall);
+    BoardSensor sensor;
+    sensor.begin();
+    std::vector<DistanceEvent> events;
+    int8_t id = sensor.subscribe(onCrossing, &events, 30, 5);
+    for (int i = 0; i < 3; i++) {
+        Sim::advance(60000);
+        sensor.update();
+    }
+    CHECK(events.empty());
+
+    sensor.setThreshold(id, 60, 5);
+    CHECK(events.size() == 1 && events[0] == DISTANCE_NEAR);
+    sensor.setThreshold(id, 47, 5);  // inside the hysteresis: still near
+    CHECK(events.size() == 1);
+    sensor.setThreshold(id, 40, 5);
+    CHECK(events.size() == 2 && events[1] == DISTANCE_CLEAR);
+    sensor.setThreshold(id, 0, 5);
+    sensor.setThreshold(id, 60, 5);
+    CHECK(events.size() == 3 && events[2] == DISTANCE_NEAR);
+    Sim::attach(NULL);
+}
+
+// CommandRing and Seqlock run on real threads here, as on the two ESP32
+// cores. A failure is always real; a pass on one run is not a proof, so
+// the loops are long and the slots and snapshots are wide enough to tear.
+struct RingItem {
+    uint32_t sequence;
+    uint32_t payload[11];   // all derived from sequence
+};
+
+static const uint32_t RING_ITEMS = 200000;
+
+static void testRingThreads() {
+    static CommandRing<RingItem, 16> ring;
+    std::atomic<bool> start(false);
+    std::thread producer([&] {
+        while (!start.load()) std::this_thread::yield();
+        RingItem item;
+        for (uint32_t n = 0; n < RING_ITEMS; n++) {
+            item.sequence = n;
+            for (uint32_t k = 0; k < 11; k++) item.payload[k] = n * 2654435761u + k;
+            while (!ring.push(item)) std::this_thread::yield();
+        }
+    });
+
+    uint32_t expected = 0, outOfOrder = 0, torn = 0;
+    uint32_t maxSize = 0;
+    start.store(true);
+    RingItem item;
+    while (expected < RING_ITEMS) {
+        maxSize = max(maxSize, ring.size());
+        if (!ring.pop(item)) {
+            std::this_thread::yield();
+            continue;
+        }
+        if (item.sequence != expected) outOfOrder++;
+        for (uint32_t k = 0; k < 11; k++) {
+            if (item.payload[k] != item.sequence * 2654435761u + k) torn++;
+        }
+        expected = item.sequence + 1;
+    }
+    producer.join();
+    CHECK(outOfOrder == 0);
+    CHECK(torn == 0);
+    CHECK(maxSize <= ring.capacity());
+    CHECK(!ring.pop(item));
+}
+
+struct Snapshot {
+    uint32_t version;
+    uint32_t fields[15];    // all equal to version
+};
+
+static void testSeqlockThreads() {
+    static Seqlock<Snapshot> lock;
+    std::atomic<bool> done(false);
+    std::thread writer([&] {
+        Snapshot next;
+        for (uint32_t n = 1; n <= RING_ITEMS; n++) {
+            next.version = n;
+            for (uint32_t &field : next.fields) field = n;
+            lock.write(next);
+            if (n % 64 == 0) std::this_thread::yield();  // lets the reader in on one core
+        }
+        done.store(true);
+    });
+
+    uint32_t reads = 0, torn = 0, backwards = 0, last = 0;
+    while (!done.load()) {
+        Snapshot copy = lock.read();
+        for (uint32_t field : copy.fields) {
+            if (field != copy.version) {
+                torn++;
+                break;
+            }
+        }
+        if (copy.version < last) backwards++;
+        last = copy.version;
+        if (++reads % 64 == 0) std::this_thread::yield();
+    }
+    writer.join();
+    CHECK(torn == 0);
+    CHECK(backwards == 0);
+    CHECK(lock.read().version == RING_ITEMS);
+    CHECK(reads > 1000);
+}
+
+// Pops like controlStep: whatever comes out, in order, joined by '|'
+static std::string drain(CommandQueue &queue) {
+    std::string ran;
+    QueuedCommand command;
+    while (queue.pop(command)) {
+        if (!ran.empty()) ran += "|";
+        ran += command.text;
+    }
+    return ran;
+}
+
+// A stop runs first and takes the motion queued before it with it; only
+// motion sent after the stop, and settings sent at any time, still run
+static void testStopFlushesQueue() {
+    CommandQueue queue;
+    queue.push("mv");
+    queue.push("st");
+    CHECK(drain(queue) == "st");
+
+    queue.push("mv");
+    queue.push("spd 150");
+    queue.push("m pos 1");
+    queue.push("st");
+    queue.push("mv");
+    CHECK(drain(queue) == "st|spd 150|m pos 1|mv");
+
+    queue.push("jb+");
+    queue.push("mv");
+    queue.push("jb0");
+    CHECK(drain(queue) == "jb0|mv");
+
+    // The repeat after the stop must not merge into the flushed mv
+    queue.push("mv");
+    queue.push("st");
+    queue.push("mv");
+    CHECK(drain(queue) == "st|mv");
+
+    queue.push("a x");
+    queue.push("js-");
+    CHECK(drain(queue) == "a x|js-");
+
+    // An arm abort leaves the wheels' commands, oa off the arm's
+    queue.push("m w");
+    queue.push("vel 0.5 0");
+    queue.push("a x");
+    CHECK(drain(queue) == "a x|vel 0.5 0");
+    queue.push("goto 50 0");
+    queue.push("g o");
+    queue.push("oa off");
+    CHECK(drain(queue) == "oa off|g o");
+
+    queue.push("m h");
+    queue.push("mv");
+    queue.push("st");
+    CHECK(drain(queue) == "st");
+    CHECK(queue.getStats().flushed == 8);
+}
+
+// Runs a batch the way batchStep and controlStep do, for ms. Drives take
+// the lease and st gives it back, as in executeCommand. Returns the ms at
+// which the lease expired, or 0.
+static unsigned long runBatch(const char *const *lines, const uint32_t *offsets, uint8_t count, unsigned long ms) {
+    Sim::reset();
+    CommandSchedule schedule;
+    CommandQueue queue;
+    DriveLease lease(500);
+    for (uint8_t i = 0; i < count; i++) schedule.add(lines[i], millis() + offsets[i]);
+    while (millis() < ms) {
+        Sim::advance(1000);
+        schedule.feed(queue, lease);
+        QueuedCommand command;
+        while (queue.pop(command)) {
+            if (CommandQueue::isDrive(command.text)) lease.grant();
+            else if (strcmp(command.text, "st") == 0) lease.release();
+        }
+        if (lease.expire()) return millis();
+    }
+    return 0;
+}
+
+// A timed batch drives through gaps longer than the lease window; after
+// its last command the deadman is back
+static void testBatchLease() {
+    const char *const routine[] = {"spd 180", "mv", "rl", "st"};
+    const uint32_t routineAt[] = {0, 0, 1500, 2200};
+    CHECK(runBatch(routine, routineAt, 4, 4000) == 0);
+
+    const char *const open[] = {"mv", "rl"};
+    const uint32_t openAt[] = {0, 1500};
+    unsigned long expiry = runBatch(open, openAt, 2, 4000);
+    CHECK(expiry >= 2000 && expiry <= 2002);
+
+    const uint32_t now[] = {0};
+    expiry = runBatch(open, now, 1, 4000);
+    CHECK(expiry >= 500 && expiry <= 502);
+}
+
+// A repeat must not merge into a command the consumer has already taken.
+// same() pops in the middle of the compare, as the other core could.
+static void testCoalesceRace() {
+    CommandRing<int, 4> ring;
+    int item;
+    ring.push(7);
+    CHECK(ring.newestMatches([](const int &pending) { return pending == 7; }));
+    CHECK(!ring.newestMatches([&](const int &pending) {
+        ring.pop(item);
+        return pending == 7;
+    }));
+    CHECK(!ring.newestMatches([](const int &) { return true; }));  // empty
+
+    CommandQueue queue;
+    queue.push("mv");
+    queue.push("mv");
+    CHECK(queue.getStats().coalesced == 1);
+    CHECK(drain(queue) == "mv");
+    queue.push("mv");
+    CHECK(drain(queue) == "mv");
+    CHECK(queue.getStats().coalesced == 1);
+}
+
+struct Test {
+    const char *name;
+    void (*run)();
+};
+
+static const Test tests[] = {
+    {"duty mapping, 8 and 10 bit", testDutyMapping},
+    {"arm abort and eased stop", testArmAbort},
+    {"threshold move fires at once", testThresholdMove},
+    {"stop flushes older commands", testStopFlushesQueue},
+    {"batch keeps the lease", testBatchLease},
+    {"no coalescing into a taken command", testCoalesceRace},
+    {"command ring, two threads", testRingThreads},
+    {"seqlock, two threads", testSeqlockThreads},
+};
+
+int main(int argc, char **argv) {
+    int failed = 0;
+    for (const Test &test : tests) {
+        if (argc > 1 && std::string(test.name).find(argv[1]) == std::string::npos) continue;
+        int before = failures;
+        test.run();
+        bool ok = failures == before;
+        if (!ok) failed++;
+        printf("%-40s %s\n", test.name, ok ? "ok" : "FAILED");
+    }
+    return failed ? 1 : 0;
+}
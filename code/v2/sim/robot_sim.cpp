@@ -0,0 +1,454 @@
+// Batch runner: drives the firmware's MotorController, UltrasonicSensor,
+// ObstacleAvoidance, Odometry, WaypointDriver and WheelSpeedControl against
+// the simulated robot over many seeded runs and prints how well each map
+// went. Build and usage are in the top-level
+// Readme, under Host Simulator.
+
+#include <Arduino.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "ObstacleAvoidance.h"
+#include "SimRobot.h"
+#include "TraceFile.h"
+#include "WaypointDriver.h"
+#include "WheelSpeedControl.h"
+#include "World.h"
+
+enum Mode { MODE_NAV, MODE_SCAN, MODE_WALL, MODE_ASSIST, MODE_ROUTE, MODE_STRAIGHT };
+
+struct Options {
+    int runs = 100;
+    uint32_t seed = 1;
+    float seconds = 60;
+    Mode mode = MODE_NAV;
+    int speed = 200;
+    float sensorAngle = 0;      // degrees, overrides the mode's default
+    bool sensorAngleSet = false;
+    float cover = 0.5f;         // coverage fraction timed by "cover"
+    float jitter = 10;          // cm of start position noise, heading gets 1.5x in degrees
+    bool corners = false;       // add the ESP32 corner sensors as an array
+    bool encoders = false;      // wheel encoders, which also close the speed loop
+    bool openLoop = false;      // encoders for odometry only
+    float wheelGains[3] = {-1, -1, -1};  // speed loop P I D, negative = firmware default
+    bool csv = false;
+    std::string tracePath;      // records the first run for trace_replay
+    SimRobot::Model model = SimRobot::defaultModel();
+    std::vector<std::string> maps;
+};
+
+struct Result {
+    uint32_t collisions;
+    uint32_t contactTime;       // ms
+    float coverage;             // 0..1
+    float distance;             // cm
+    float coverTime;            // s, -1 if never reached
+    float wallError;            // cm, RMS from the target, wall mode only
+    float lapTime;              // s back at the start, -1 if never
+    float odometryError;        // cm between the odometry and the true position at the end
+    float routeTime;            // s to the last waypoint, route mode, -1 if never
+    float routeMiss;            // cm from the last waypoint on arrival
+    float offset;               // cm off the start line at the end, straight mode
+    float headingError;         // degrees off the start heading at the end, straight mode
+    float speedError;           // mm/s, RMS of the wheels from the speed loop's setpoint
+};
+
+static const unsigned long LOOP_TIME = 1000;  // us per pass of the control loop
+static const float WALL_TARGET = 25.0f;
+static const unsigned long WARMUP = 3000;     // ms before wall error counts
+static const float LAP_AWAY = 100.0f;         // cm from the start before a lap can end
+static const float LAP_RADIUS = 30.0f;
+// The host build uses the ESP8266 pin set, which has no corner pins
+static const uint8_t CORNER_TRIG[2] = {40, 41}, CORNER_ECHO[2] = {42, 43};
+static const float CORNER_ANGLE = 45.0f;
+static const uint8_t ENCODER_PINS[2] = {44, 45};
+
+static const char *modeName(Mode mode) {
+    switch (mode) {
+        case MODE_SCAN: return "scan";
+        case MODE_WALL: return "wall";
+        case MODE_ASSIST: return "assist";
+        case MODE_ROUTE: return "route";
+        case MODE_STRAIGHT: return "straight";
+        default: return "nav";
+    }
+}
+
+static void usage() {
+    fprintf(stderr,
+            "usage: robot_sim [options] map...\n"
+            "  --runs N           runs per map (100)\n"
+            "  --seed S           first seed, run i uses S+i (1)\n"
+            "  --time SEC         simulated seconds per run (60)\n"
+            "  --mode M           nav, scan, wall, assist, route or straight (nav)\n"
+            "  --speed DUTY       speed setting, 0-255 (200)\n"
+            "  --sensor-angle DEG sensor direction, CCW from ahead (0, wall: -90)\n"
+            "  --noise CM         reading noise std dev (1)\n"
+            "  --dropout P        chance of a lost echo (0.02)\n"
+            "  --beam DEG         sensor cone width (15)\n"
+            "  --corners          add two array sensors at +-45 degrees\n"
+            "  --encoders         add wheel encoders and close the speed loop\n"
+            "  --open-loop        with --encoders, leave the speed loop off\n"
+            "  --wheel-pid P I D  speed loop gains (firmware defaults)\n"
+            "  --mismatch F       right motor weaker than the left by F (0)\n"
+            "  --sag F            top speed lost per minute of battery (0)\n"
+            "  --cover F          coverage fraction to time (0.5)\n"
+            "  --jitter CM        start pose noise (10)\n"
+            "  --csv              one line per run instead of a summary\n"
+            "  --trace FILE       record the first run as a sensor trace\n");
+}
+
+static bool parseOptions(int argc, char **argv, Options &options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--csv") {
+            options.csv = true;
+        } else if (arg == "--corners") {
+            options.corners = true;
+        } else if (arg == "--encoders") {
+            options.encoders = true;
+        } else if (arg == "--open-loop") {
+            options.openLoop = true;
+        } else if (arg.compare(0, 2, "--") != 0) {
+            options.maps.push_back(arg);
+        } else if (!hasValue) {
+            return false;
+        } else if (arg == "--runs") {
+            options.runs = atoi(argv[++i]);
+        } else if (arg == "--seed") {
+            options.seed = strtoul(argv[++i], NULL, 10);
+        } else if (arg == "--time") {
+            options.seconds = atof(argv[++i]);
+        } else if (arg == "--speed") {
+            options.speed = atoi(argv[++i]);
+        } else if (arg == "--sensor-angle") {
+            options.sensorAngle = atof(argv[++i]);
+            options.sensorAngleSet = true;
+        } else if (arg == "--noise") {
+            options.model.noise = atof(argv[++i]);
+        } else if (arg == "--dropout") {
+            options.model.dropout = atof(argv[++i]);
+        } else if (arg == "--beam") {
+            options.model.beamWidth = atof(argv[++i]);
+        } else if (arg == "--mismatch") {
+            options.model.mismatch = atof(argv[++i]);
+        } else if (arg == "--sag") {
+            options.model.sag = atof(argv[++i]);
+        } else if (arg == "--wheel-pid") {
+            if (i + 3 >= argc) return false;
+            for (int k = 0; k < 3; k++) options.wheelGains[k] = atof(argv[++i]);
+        } else if (arg == "--cover") {
+            options.cover = atof(argv[++i]);
+        } else if (arg == "--jitter") {
+            options.jitter = atof(argv[++i]);
+        } else if (arg == "--trace") {
+            options.tracePath = argv[++i];
+        } else if (arg == "--mode") {
+            std::string mode = argv[++i];
+            if (mode == "nav") options.mode = MODE_NAV;
+            else if (mode == "scan") options.mode = MODE_SCAN;
+            else if (mode == "wall") options.mode = MODE_WALL;
+            else if (mode == "assist") options.mode = MODE_ASSIST;
+            else if (mode == "route") options.mode = MODE_ROUTE;
+            else if (mode == "straight") options.mode = MODE_STRAIGHT;
+            else return false;
+        } else {
+            return false;
+        }
+    }
+    return !options.maps.empty() && options.runs > 0 && options.seconds > 0;
+}
+
+// Start pose with noise, retried until it is clear of the walls
+static void placeRobot(SimRobot &robot, const World &world, const Options &options, std::mt19937 &rng) {
+    std::uniform_real_distribution<float> offset(-1.0f, 1.0f);
+    for (int attempt = 0; attempt < 20; attempt++) {
+        float x = world.startX + options.jitter * offset(rng);
+        float y = world.startY + options.jitter * offset(rng);
+        float h = world.startHeading + options.jitter * 1.5f * DEG_TO_RAD * offset(rng);
+        if (!world.collides(x, y, options.model.radius)) {
+            robot.place(x, y, h);
+            return;
+        }
+    }
+    robot.place(world.startX, world.startY, world.startHeading);
+}
+
+// OA's blocking maneuvers call this, as motionWaitHook on the robot
+static Odometry *waitOdometry = NULL;
+static WheelSpeedControl *waitWheels = NULL;
+
+static bool keepTracking() {
+    waitOdometry->update();
+    waitWheels->update();
+    return false;
+}
+
+static Result runOnce(const World &world, const Options &options, uint32_t seed, SensorTrace *trace) {
+    Sim::reset();
+    std::mt19937 rng(seed);
+    SimRobot robot(world, options.model, seed * 2654435761u);
+    float sensorAngle = options.sensorAngleSet ? options.sensorAngle : (options.mode == MODE_WALL ? -90.0f : 0.0f);
+    robot.clearSensors();
+    robot.addSensor(Board::Pins::ECHO_PIN, 8.0f, sensorAngle);
+    if (options.corners) {
+        robot.addSensor(CORNER_ECHO[0], 6.0f, CORNER_ANGLE, CORNER_TRIG[0]);
+        robot.addSensor(CORNER_ECHO[1], 6.0f, -CORNER_ANGLE, CORNER_TRIG[1]);
+    }
+    if (options.encoders) robot.setEncoders(ENCODER_PINS[0], ENCODER_PINS[1]);
+    placeRobot(robot, world, options, rng);
+    Sim::attach(&robot);
+
+    // Fresh firmware objects each run, wired as in code.ino
+    BoardMotors motors;
+    BoardSensor sensor;
+    BoardSensorArray array;
+    ObstacleAvoidance oa(&motors, &sensor);
+    BoardEncoders encoders;
+    Odometry odometry(&motors, &encoders);
+    WaypointDriver route(&motors, &odometry);
+    WheelSpeedControl wheels(&motors, &encoders, &odometry);
+    TraceTap tap = {trace, &motors, &oa};
+    motors.begin();
+    sensor.begin();
+    if (trace) sensor.subscribe(TraceTap::onSample, &tap);
+    if (options.corners) {
+        array.addSensor(CORNER_TRIG[0], CORNER_ECHO[0], CORNER_ANGLE, 0);
+        array.addSensor(CORNER_TRIG[1], CORNER_ECHO[1], -CORNER_ANGLE, 0);
+    }
+    array.setLead(&sensor);
+    array.begin();
+    oa.begin();
+    oa.setSensorArray(&array);
+    // The host pin set has no encoder pins either
+    if (options.encoders) encoders.begin(ENCODER_PINS[0], ENCODER_PINS[1]);
+    odometry.begin();
+    wheels.begin();
+    if (options.openLoop) wheels.enable(false);
+    if (options.wheelGains[0] >= 0) wheels.setGains(options.wheelGains[0], options.wheelGains[1], options.wheelGains[2]);
+    waitOdometry = &odometry;
+    waitWheels = &wheels;
+    oa.setWaitHook(keepTracking);
+    motors.setSpeed(options.speed);
+    oa.setRotationRate(robot.rotationRate());
+
+    // Calibrated from the model, as "odo cal" would be on the robot, and
+    // started from the true pose so the drift is the odometry's own
+    Odometry::Calibration calibration = odometry.getCalibration();
+    calibration.maxSpeed = lroundf(options.model.maxSpeed * 10);
+    calibration.wheelBase = lroundf(options.model.wheelBase * 10);
+    calibration.stallDuty = options.model.stallDuty * BoardMotors::MAX_DUTY / 255;
+    calibration.lag = lroundf(options.model.motorLag * 1000);
+    calibration.tickLength = lroundf(options.model.tickLength * 10000);
+    odometry.setCalibration(calibration);
+    odometry.reset(robot.x, robot.y, robot.heading * RAD_TO_DEG);
+
+    switch (options.mode) {
+        case MODE_NAV: oa.startNavigation(ObstacleAvoidance::NAV_RIGHT_TURN); break;
+        case MODE_SCAN: oa.startNavigation(ObstacleAvoidance::NAV_SCAN); break;
+        case MODE_WALL:
+            oa.setWallFollowing(WALL_TARGET, 0, -sensorAngle);
+            oa.startNavigation(ObstacleAvoidance::NAV_WALL);
+            break;
+        case MODE_ASSIST: oa.enable(); break;
+        case MODE_ROUTE:
+            oa.enable();
+            for (const World::Point &p : world.waypoints) route.add(p.x, p.y);
+            route.start();
+            break;
+        case MODE_STRAIGHT: break;  // open floor, OA off, forward held below
+    }
+    if (trace) {
+        TraceHeader settings = {};  // as startTrace() in code.ino
+        settings.navMode = oa.getNavMode();
+        settings.flags = TRACE_OA_ACTIVE | (oa.navigating() ? TRACE_NAVIGATING : 0);
+        settings.speed = motors.getSpeed();
+        settings.maxDuty = BoardMotors::MAX_DUTY;
+        settings.rotationRate = oa.getRotationRate() * 10 + 0.5f;
+        settings.wallTarget = oa.getWallTarget();
+        settings.wallSpeed = oa.getWallSpeed() * 100;
+        settings.wallAngle = oa.getWallAngle();
+        trace->start(settings, millis());
+    }
+
+    Result result = {0, 0, 0, 0, -1, 0, -1, 0, -1, 0, 0, 0, 0};
+    float startX = robot.x, startY = robot.y, startHeading = robot.heading;
+    bool away = false;
+    double wallSum = 0, speedSum = 0;
+    uint32_t wallCount = 0, speedCount = 0;
+    unsigned long nextWallSample = WARMUP, nextSpeedSample = 0;
+    unsigned long end = (unsigned long)(options.seconds * 1000);
+
+    while (millis() < end) {
+        // An operator holding forward; a straight run ends at the first wall
+        if (options.mode == MODE_ASSIST || options.mode == MODE_STRAIGHT) motors.moveForward();
+        if (options.mode == MODE_STRAIGHT && robot.collisions) break;
+        sensor.update();
+        array.update();
+        motors.update();
+        odometry.update();
+        wheels.update();
+        oa.update();
+        route.update();
+        Sim::advance(LOOP_TIME);
+
+        unsigned long now = millis();
+        if (options.mode == MODE_ROUTE && result.routeTime < 0 && route.getState() == WaypointDriver::ROUTE_ARRIVED) {
+            const World::Point &last = world.waypoints.back();
+            result.routeTime = now / 1000.0f;
+            result.routeMiss = hypotf(robot.x - last.x, robot.y - last.y);
+        }
+        if (result.coverTime < 0 && robot.coverage() >= options.cover) result.coverTime = now / 1000.0f;
+
+        // The wheels against what the model expects of them, loop or not
+        if (now >= nextSpeedSample) {
+            nextSpeedSample = now + WheelSpeedControl::INTERVAL;
+            float left = robot.leftSpeed * 10 - odometry.getModelSpeed(BoardMotors::WHEEL_LEFT);
+            float right = robot.rightSpeed * 10 - odometry.getModelSpeed(BoardMotors::WHEEL_RIGHT);
+            speedSum += left * left + right * right;
+            speedCount += 2;
+        }
+
+        if (options.mode == MODE_WALL && now >= nextWallSample) {
+            nextWallSample = now + 50;
+            float side = robot.heading + (sensorAngle < 0 ? -1.0f : 1.0f) * (float)M_PI / 2;
+            float error = world.raycast(robot.x, robot.y, side, 1000.0f) - WALL_TARGET;
+            wallSum += error * error;
+            wallCount++;
+        }
+
+        float dx = robot.x - startX, dy = robot.y - startY;
+        float fromStart = sqrtf(dx * dx + dy * dy);
+        if (fromStart > LAP_AWAY) away = true;
+        if (away && result.lapTime < 0 && fromStart < LAP_RADIUS) result.lapTime = now / 1000.0f;
+    }
+    Sim::attach(NULL);
+
+    Odometry::Pose pose = odometry.getPose();
+    result.odometryError = hypotf(Odometry::toCm(pose.x) - robot.x, Odometry::toCm(pose.y) - robot.y);
+    result.collisions = robot.collisions;
+    result.contactTime = robot.contactTime;
+    result.coverage = robot.coverage();
+    result.distance = robot.travelled;
+    result.wallError = wallCount ? sqrtf(wallSum / wallCount) : 0;
+    result.speedError = speedCount ? sqrtf(speedSum / speedCount) : 0;
+    float dx = robot.x - startX, dy = robot.y - startY;
+    result.offset = dy * cosf(startHeading) - dx * sinf(startHeading);  // left positive
+    result.headingError = remainderf(robot.heading - startHeading, 2 * (float)M_PI) * (float)RAD_TO_DEG;
+    return result;
+}
+
+static void printSummary(const World &world, const Options &options, const std::vector<Result> &results) {
+    double collisions = 0, coverage = 0, distance = 0, coverTime = 0, wallError = 0, lapTime = 0;
+    double odometryError = 0, routeTime = 0, routeMiss = 0, offset = 0, headingError = 0, speedError = 0;
+    int clean = 0, covered = 0, laps = 0, routes = 0;
+    for (const Result &r : results) {
+        collisions += r.collisions;
+        coverage += r.coverage;
+        distance += r.distance;
+        wallError += r.wallError;
+        odometryError += r.odometryError;
+        offset += fabsf(r.offset);
+        headingError += fabsf(r.headingError);
+        speedError += r.speedError;
+        if (r.routeTime >= 0) {
+            routeTime += r.routeTime;
+            routeMiss += r.routeMiss;
+            routes++;
+        }
+        if (r.collisions == 0) clean++;
+        if (r.coverTime >= 0) {
+            coverTime += r.coverTime;
+            covered++;
+        }
+        if (r.lapTime >= 0) {
+            lapTime += r.lapTime;
+            laps++;
+        }
+    }
+    double n = results.size();
+    printf("%-14s %-6s collisions %5.2f/run  clean %3.0f%%  coverage %3.0f%%  distance %6.0fcm",
+           world.getName().c_str(), modeName(options.mode), collisions / n, 100.0 * clean / n,
+           100.0 * coverage / n, distance / n);
+    if (covered) {
+        printf("  %.0f%% in %5.1fs (%d/%d)", options.cover * 100, coverTime / covered, covered, (int)n);
+    } else {
+        printf("  %.0f%% never", options.cover * 100);
+    }
+    if (options.mode == MODE_WALL) {
+        printf("  wall rms %4.1fcm", wallError / n);
+        if (laps) printf("  lap %5.1fs (%d/%d)", lapTime / laps, laps, (int)n);
+    }
+    if (options.mode == MODE_ROUTE) {
+        if (routes) {
+            printf("  route %5.1fs (%d/%d) miss %4.1fcm", routeTime / routes, routes, (int)n, routeMiss / routes);
+        } else {
+            printf("  route never");
+        }
+    }
+    if (options.mode == MODE_STRAIGHT) {
+        printf("  off line %5.1fcm  heading %5.1fdeg", offset / n, headingError / n);
+    }
+    printf("  odometry drift %5.1fcm  wheel speed rms %5.1fmm/s", odometryError / n, speedError / n);
+    printf("\n");
+}
+
+int main(int argc, char **argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        usage();
+        return 2;
+    }
+
+    std::vector<World> worlds(options.maps.size());
+    for (size_t i = 0; i < options.maps.size(); i++) {
+        std::string error;
+        if (!worlds[i].load(options.maps[i].c_str(), error)) {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+        if (options.mode == MODE_ROUTE && worlds[i].waypoints.empty()) {
+            fprintf(stderr, "%s: route mode needs waypoint lines\n", options.maps[i].c_str());
+            return 1;
+        }
+    }
+
+    if (options.csv) {
+        printf("map,mode,seed,collisions,contact_ms,coverage,distance_cm,cover_s,wall_rms_cm,lap_s,"
+               "odometry_cm,route_s,route_miss_cm,offset_cm,heading_deg,speed_rms_mm_s\n");
+    }
+    static SensorTrace trace;
+    auto started = std::chrono::steady_clock::now();
+    int total = 0;
+    for (const World &world : worlds) {
+        std::vector<Result> results;
+        for (int i = 0; i < options.runs; i++) {
+            uint32_t seed = options.seed + i;
+            bool record = !options.tracePath.empty() && total == 0 && i == 0;
+            Result r = runOnce(world, options, seed, record ? &trace : NULL);
+            results.push_back(r);
+            if (options.csv) {
+                printf("%s,%s,%u,%u,%u,%.3f,%.0f,%.1f,%.2f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f\n",
+                       world.getName().c_str(), modeName(options.mode), seed, r.collisions, r.contactTime,
+                       r.coverage, r.distance, r.coverTime, r.wallError, r.lapTime, r.odometryError,
+                       r.routeTime, r.routeMiss, r.offset, r.headingError, r.speedError);
+            }
+        }
+        if (!options.csv) printSummary(world, options, results);
+        total += options.runs;
+    }
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    if (!options.tracePath.empty()) {
+        std::string error;
+        if (!writeTrace(options.tracePath.c_str(), trace, error)) {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+        fprintf(stderr, "trace: %u samples to %s\n", trace.size(), options.tracePath.c_str());
+    }
+    fprintf(stderr, "%d runs of %.0fs in %.2fs: %.0f runs/s, %.0fx real time\n", total, options.seconds,
+            elapsed, total / elapsed, total * options.seconds / elapsed);
+    return 0;
+}
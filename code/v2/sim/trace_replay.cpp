@@ -0,0 +1,200 @@
+// Replays recorded ultrasonic traces through the firmware's UltrasonicSensor
+// and ObstacleAvoidance and compares the wheel duties they produce with the
+// recorded ones. Record with "trace on" and GET /trace on the robot, or with
+// robot_sim --trace. Usage is in the top-level Readme, under Host Simulator.
+
+#include <Arduino.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "ObstacleAvoidance.h"
+#include "TraceFile.h"
+
+// Answers each pulseIn with the next recorded echo
+class TracePlayer : public Sim::Hardware {
+  public:
+    explicit TracePlayer(const std::vector<TraceEntry> &e) : entries(e), position(0) {}
+
+    void step(uint32_t) override {}
+
+    unsigned long echo(uint8_t, unsigned long timeout) override {
+        if (position >= entries.size()) return 0;
+        unsigned long duration = entries[position++].echo;
+        return duration < timeout ? duration : 0;
+    }
+
+    size_t played() const { return position; }
+
+  private:
+    const std::vector<TraceEntry> &entries;
+    size_t position;
+};
+
+struct Options {
+    int warmup = 3;             // samples not compared while the filters fill
+    float tolerance = 5;        // % of full duty a replayed duty may differ by
+    float rotationRate = 0;     // deg/s, 0 = as recorded
+    bool csv = false;
+    std::vector<std::string> traces;
+};
+
+struct Replay {
+    size_t samples;
+    size_t mismatches;
+    long firstMismatch;         // sample index, -1 = none
+    int maxDifference;          // in replay duty units
+    float seconds;              // recorded time covered
+};
+
+static const unsigned long TAIL = 1000;  // ms run past the last entry before giving up
+
+static void usage() {
+    fprintf(stderr,
+            "usage: trace_replay [options] trace...\n"
+            "  --warmup N       samples skipped while the filters fill (3)\n"
+            "  --tolerance PCT  allowed duty difference, %% of full duty (5)\n"
+            "  --rate DEG       OA rotation rate instead of the recorded one\n"
+            "  --csv            print recorded and replayed duties per sample\n");
+}
+
+static bool parseOptions(int argc, char **argv, Options &options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--csv") {
+            options.csv = true;
+        } else if (arg.compare(0, 2, "--") != 0) {
+            options.traces.push_back(arg);
+        } else if (!hasValue) {
+            return false;
+        } else if (arg == "--warmup") {
+            options.warmup = atoi(argv[++i]);
+        } else if (arg == "--tolerance") {
+            options.tolerance = atof(argv[++i]);
+        } else if (arg == "--rate") {
+            options.rotationRate = atof(argv[++i]);
+        } else {
+            return false;
+        }
+    }
+    return !options.traces.empty();
+}
+
+// Recorded duty in this build's units; an ESP32 trace runs at 10 bits
+static int scaleDuty(int duty, const TraceHeader &header) {
+    if (header.maxDuty <= 0 || header.maxDuty == BoardMotors::MAX_DUTY) return duty;
+    return (int)lroundf((float)duty * BoardMotors::MAX_DUTY / header.maxDuty);
+}
+
+// Runs the control loop in virtual time. Reads in the main loop happen at
+// the recorded times; reads inside a blocking maneuver happen whenever the
+// maneuver asks, as on the robot, and take the next echo either way.
+static Replay replay(const char *name, const TraceHeader &header, const std::vector<TraceEntry> &entries,
+                     const Options &options) {
+    std::vector<unsigned long> due(entries.size() + 1);
+    unsigned long time = header.startTime;
+    for (size_t i = 0; i < entries.size(); i++) {
+        time += entries[i].dt;
+        due[i] = time;
+    }
+    due[entries.size()] = time + TAIL;
+
+    Sim::reset();
+    TracePlayer player(entries);
+    Sim::attach(&player);
+    for (unsigned long ms = 0; ms < header.startTime; ms += 1000) {
+        Sim::advance(min(header.startTime - ms, 1000UL) * 1000);
+    }
+
+    BoardMotors motors;
+    BoardSensor sensor;
+    ObstacleAvoidance oa(&motors, &sensor);
+    SensorTrace replayed;
+    TraceTap tap = {&replayed, &motors, &oa};
+    motors.begin();
+    sensor.begin();
+    sensor.subscribe(TraceTap::onSample, &tap);
+    oa.begin();
+    motors.setSpeed(scaleDuty(header.speed, header));
+    oa.setRotationRate(options.rotationRate > 0 ? options.rotationRate : header.rotationRate / 10.0f);
+    oa.setWallFollowing(header.wallTarget, header.wallSpeed / 100.0f, header.wallAngle);
+    oa.startNavigation((ObstacleAvoidance::NavMode)header.navMode);
+
+    TraceHeader settings = header;
+    settings.speed = motors.getSpeed();
+    settings.maxDuty = BoardMotors::MAX_DUTY;
+    replayed.start(settings, millis());
+
+    while (player.played() < entries.size() && replayed.isRecording() && millis() < due[entries.size()]) {
+        if (millis() >= due[player.played()]) sensor.update();
+        motors.update();
+        oa.update();
+        Sim::advance(1000);
+    }
+    Sim::attach(NULL);
+
+    Replay result = {replayed.size(), 0, -1, 0, (time - header.startTime) / 1000.0f};
+    int tolerance = (int)(options.tolerance / 100.0f * BoardMotors::MAX_DUTY + 0.5f);
+    const TraceEntry *played = replayed.getEntries();
+    for (size_t i = 0; i < replayed.size() && i < entries.size(); i++) {
+        int left = scaleDuty(entries[i].left, header), right = scaleDuty(entries[i].right, header);
+        int difference = max(abs(played[i].left - left), abs(played[i].right - right));
+        if (options.csv) {
+            printf("%s,%zu,%lu,%u,%d,%d,%d,%d\n", name, i, due[i] - header.startTime, entries[i].echo,
+                   left, right, played[i].left, played[i].right);
+        }
+        if ((int)i < options.warmup) continue;
+        result.maxDifference = max(result.maxDifference, difference);
+        if (difference > tolerance) {
+            result.mismatches++;
+            if (result.firstMismatch < 0) result.firstMismatch = i;
+        }
+    }
+    // Samples the replay never reached count against it
+    if (replayed.size() < entries.size()) {
+        result.mismatches += entries.size() - replayed.size();
+        if (result.firstMismatch < 0) result.firstMismatch = replayed.size();
+    }
+    return result;
+}
+
+int main(int argc, char **argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        usage();
+        return 2;
+    }
+
+    static const char *modes[] = {"nav", "scan", "wall"};
+    bool failed = false;
+    if (options.csv) printf("trace,sample,t_ms,echo_us,left,right,replay_left,replay_right\n");
+    for (const std::string &path : options.traces) {
+        TraceHeader header;
+        std::vector<TraceEntry> entries;
+        std::string error;
+        if (!readTrace(path.c_str(), header, entries, error)) {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 2;
+        }
+        // Driving by hand is not in the trace, so only navigation replays
+        if (!(header.flags & TRACE_NAVIGATING) || header.navMode > ObstacleAvoidance::NAV_WALL) {
+            fprintf(stderr, "%s: not recorded during navigation, skipped\n", path.c_str());
+            continue;
+        }
+
+        auto started = std::chrono::steady_clock::now();
+        Replay r = replay(path.c_str(), header, entries, options);
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        if (r.mismatches) failed = true;
+        if (options.csv) continue;
+
+        printf("%-20s %-4s %5zu samples %6.1fs in %5.1fms (%.0fx)  ", path.c_str(), modes[header.navMode],
+               entries.size(), r.seconds, elapsed * 1000, r.seconds / max(elapsed, 1e-6));
+        if (r.mismatches) {
+            printf("%zu mismatched from sample %ld, max %d duty\n", r.mismatches, r.firstMismatch, r.maxDifference);
+        } else {
+            printf("match, max %d duty\n", r.maxDifference);
+        }
+    }
+    return failed ? 1 : 0;
+}
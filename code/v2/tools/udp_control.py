@@ -0,0 +1,135 @@
+#!/usr/bin/env python3
+"""Send robot commands over the UDP control port, or benchmark it against HTTP.
+
+Datagram: uint32 sequence (little-endian), uint8 flags, command text.
+Ack:      the same sequence and one status byte.
+
+    udp_control.py 192.168.1.50 mv "vel 0.5 0" st
+    udp_control.py robot.local --bench 200
+    udp_control.py 127.0.0.1 --port 4210 --http-port 8080 --bench 500
+
+Standard library only.
+"""
+
+import argparse
+import socket
+import statistics
+import struct
+import sys
+import time
+import urllib.parse
+import urllib.request
+
+FLAG_ACK = 0x01
+STATUS = {0: "ok", 1: "queue full", 2: "stale", 3: "invalid"}
+
+
+class UdpControl:
+    def __init__(self, host, port, timeout, retries):
+        self.address = (socket.gethostbyname(host), port)
+        self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.sock.settimeout(timeout)
+        self.retries = retries
+        # Start past zero so a restarted client is not mistaken for a replay
+        self.sequence = int(time.time() * 1000) & 0x7FFFFFFF
+
+    def send(self, command, ack=True):
+        """Returns the ack status, None if no ack came back, or "sent"."""
+        self.sequence = (self.sequence + 1) & 0xFFFFFFFF
+        packet = struct.pack("<IB", self.sequence, FLAG_ACK if ack else 0) + command.encode()
+        for attempt in range(self.retries + 1):
+            self.sock.sendto(packet, self.address)
+            if not ack:
+                return "sent"
+            status = self._wait_ack(self.sequence)
+            if status is not None:
+                # "stale" on a retry means the first copy got through
+                return "ok" if attempt and status == "stale" else status
+        return None
+
+    def _wait_ack(self, sequence):
+        deadline = time.monotonic() + self.sock.gettimeout()
+        while time.monotonic() < deadline:
+            try:
+                data, _ = self.sock.recvfrom(64)
+            except socket.timeout:
+                return None
+            if len(data) >= 5:
+                seq, status = struct.unpack("<IB", data[:5])
+                if seq == sequence:
+                    return STATUS.get(status, str(status))
+        return None
+
+
+def http_send(host, port, command, timeout):
+    url = "http://%s:%d/command?cmd=%s" % (host, port, urllib.parse.quote(command))
+    with urllib.request.urlopen(url, timeout=timeout) as response:
+        response.read()
+        return response.status
+
+
+def summarize(name, samples, lost):
+    if not samples:
+        print("%-5s no replies (%d lost)" % (name, lost))
+        return
+    samples.sort()
+    p95 = samples[min(len(samples) - 1, int(len(samples) * 0.95))]
+    print("%-5s n=%-5d lost=%-4d mean=%7.2f ms  median=%7.2f ms  p95=%7.2f ms  max=%7.2f ms" % (
+        name, len(samples), lost, statistics.mean(samples), statistics.median(samples), p95, samples[-1]))
+
+
+def bench(args, udp):
+    # "hb" is answered before the command queue on both paths, so this
+    # measures transport and dispatch, not the control loop
+    udp_ms, udp_lost = [], 0
+    for _ in range(args.bench):
+        start = time.perf_counter()
+        if udp.send(args.command) is None:
+            udp_lost += 1
+        else:
+            udp_ms.append((time.perf_counter() - start) * 1000)
+        time.sleep(args.interval / 1000)
+
+    http_ms, http_lost = [], 0
+    for _ in range(args.bench):
+        start = time.perf_counter()
+        try:
+            http_send(args.host, args.http_port, args.command, args.timeout)
+            http_ms.append((time.perf_counter() - start) * 1000)
+        except OSError:
+            http_lost += 1
+        time.sleep(args.interval / 1000)
+
+    summarize("udp", udp_ms, udp_lost)
+    summarize("http", http_ms, http_lost)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("host")
+    parser.add_argument("commands", nargs="*")
+    parser.add_argument("--port", type=int, default=4210, help="UDP control port")
+    parser.add_argument("--http-port", type=int, default=80)
+    parser.add_argument("--timeout", type=float, default=0.2, help="seconds to wait for an ack")
+    parser.add_argument("--retries", type=int, default=2)
+    parser.add_argument("--no-ack", action="store_true", help="fire and forget")
+    parser.add_argument("--bench", type=int, metavar="N", help="round-trip N commands over UDP, then HTTP")
+    parser.add_argument("--command", default="hb", help="command used by --bench")
+    parser.add_argument("--interval", type=float, default=10, help="ms between bench commands")
+    args = parser.parse_intermixed_args()
+
+    udp = UdpControl(args.host, args.port, args.timeout, args.retries)
+    if args.bench:
+        bench(args, udp)
+        return 0
+
+    failed = 0
+    for command in args.commands:
+        status = udp.send(command, ack=not args.no_ack)
+        print("%-20s %s" % (command, status or "no ack"))
+        failed += status not in ("ok", "sent")
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())